@@ -0,0 +1,57 @@
+/**
+Arduino.cpp
+
+Host build of the Arduino core - see extras/host/README.md.
+
+The simulated clock. 
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "Arduino.h"
+
+static uint64_t clockMicros = 0;
+static uint32_t callCost = 1;
+
+uint64_t hostClock()
+{
+	return clockMicros;
+}
+
+void hostAdvance(uint64_t us)
+{
+	clockMicros += us;
+}
+
+void hostSetCallCost(uint32_t us)
+{
+	callCost = us;
+}
+
+void hostTick()
+{
+	clockMicros += callCost;
+}
+
+unsigned long millis()
+{
+	hostTick();
+	return (unsigned long)(clockMicros / 1000);
+}
+
+unsigned long micros()
+{
+	hostTick();
+	return (unsigned long)clockMicros;
+}
+
+void delay(unsigned long ms)
+{
+	clockMicros += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	clockMicros += us;
+}
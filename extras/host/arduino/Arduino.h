@@ -0,0 +1,87 @@
+/**
+Arduino.h
+
+Host build of the Arduino core - see extras/host/README.md.
+
+Just enough of the core for the library to build and run on a desktop 
+machine against the simulated module in extras/host/sim. Time is simulated
+too: it only moves forward when something waits (delay(), or a uart that is
+still shifting bytes out) and by a small cost for every call that polls, so
+a run gives the same timings every time and takes no real time at all.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <type_traits>
+#include <string>
+
+#include "Stream.h"
+#include "HardwareSerial.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// templates rather than the avr macros, so the standard headers still build
+template <typename T, typename U>
+inline typename std::common_type<T, U>::type min(T a, U b)
+{
+	return (b < a) ? b : a;
+}
+
+template <typename T, typename U>
+inline typename std::common_type<T, U>::type max(T a, U b)
+{
+	return (a < b) ? b : a;
+}
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+class String
+{
+public:
+	String(const char *str = "") : _str(str) {}
+	String(const std::string &str) : _str(str) {}
+
+	const char * c_str() const { return _str.c_str(); }
+	unsigned int length() const { return _str.length(); }
+	char operator[](unsigned int index) const { return _str[index]; }
+	bool operator==(const String &rhs) const { return _str == rhs._str; }
+	String & operator+=(const String &rhs) { _str += rhs._str; return *this; }
+
+private:
+	std::string _str;
+};
+
+//////////////////////
+// Host Only        //
+//////////////////////
+
+// the simulated clock, in microseconds since the program started
+uint64_t hostClock();
+
+// move the clock forward (as if the sketch had been busy for that long)
+void hostAdvance(uint64_t us);
+
+// how long each millis(), micros(), available(), read() or peek() takes - this stops a 
+// polling loop spinning forever and roughly models an avr's loop overhead
+void hostSetCallCost(uint32_t us);
+void hostTick();
+
+#endif
@@ -0,0 +1,194 @@
+/**
+HardwareSerial.cpp
+
+Host build of the Arduino core - see extras/host/README.md.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "Arduino.h"
+
+HardwareSerial Serial;
+
+HostUartPeer *HostUart::_peer = NULL;
+
+HostUart::HostUart(bool blockingWrite)
+{
+	_blocking = blockingWrite;
+	_rxHead = 0;
+	_rxCount = 0;
+	_rxEnd = 0;
+	_overruns = 0;
+	_txEnd = 0;
+	begin(9600);
+}
+
+void HostUart::begin(unsigned long baud)
+{
+	// 8N1 is 10 bits a byte
+	_baud = baud;
+	_byteTime = (10000000UL + baud / 2) / baud;
+}
+
+void HostUart::end()
+{
+	_line.clear();
+	_rxCount = 0;
+}
+
+// hand every byte from now on to [peer]
+void HostUart::attach(HostUartPeer *peer)
+{
+	_peer = peer;
+}
+
+unsigned long HostUart::baud() const
+{
+	return _baud;
+}
+
+// microseconds to send one byte
+uint32_t HostUart::byteTime() const
+{
+	return _byteTime;
+}
+
+// put bytes on the line towards us, starting at [at] (or as soon as the line
+// is free) - returns the time the last one will have arrived
+uint64_t HostUart::inject(const uint8_t *data, size_t size, uint64_t at)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		_rxEnd = ((at > _rxEnd) ? at : _rxEnd) + _byteTime;
+		PendingByte b = { data[i], _rxEnd };
+		_line.push_back(b);
+	}
+	return _rxEnd;
+}
+
+// when the line towards us next goes quiet
+uint64_t HostUart::rxIdle() const
+{
+	return _rxEnd;
+}
+
+// bytes lost because the receive buffer was full when they arrived
+uint32_t HostUart::overruns() const
+{
+	return _overruns;
+}
+
+// move everything that has arrived by now into the receive buffer
+void HostUart::receive()
+{
+	uint64_t now = hostClock();
+	if (_peer != NULL)
+	{
+		_peer->uartPoll(*this, now);
+	}
+	while (!_line.empty() && (_line.front().at <= now))
+	{
+		if (_rxCount < SERIAL_RX_BUFFER_SIZE)
+		{
+			_rx[(_rxHead + _rxCount) % SERIAL_RX_BUFFER_SIZE] = _line.front().c;
+			_rxCount++;
+		}
+		else
+		{
+			_overruns++;
+		}
+		_line.pop_front();
+	}
+}
+
+int HostUart::available()
+{
+	hostTick();
+	receive();
+	return _rxCount;
+}
+
+int HostUart::read()
+{
+	hostTick();
+	receive();
+	if (_rxCount == 0)
+	{
+		return -1;
+	}
+	uint8_t c = _rx[_rxHead];
+	_rxHead = (_rxHead + 1) % SERIAL_RX_BUFFER_SIZE;
+	_rxCount--;
+	return c;
+}
+
+int HostUart::peek()
+{
+	hostTick();
+	receive();
+	if (_rxCount == 0)
+	{
+		return -1;
+	}
+	return _rx[_rxHead];
+}
+
+// wait for everything we have written to go
+void HostUart::flush()
+{
+	uint64_t now = hostClock();
+	if (_txEnd > now)
+	{
+		hostAdvance(_txEnd - now);
+	}
+}
+
+size_t HostUart::write(uint8_t c)
+{
+	uint64_t now = hostClock();
+	if (_blocking)
+	{
+		// bit banged, so nothing else happens until the byte has gone
+		hostAdvance(_byteTime);
+		_txEnd = now + _byteTime;
+	}
+	else
+	{
+		// queue behind whatever is still going out, and if the buffer is 
+		// full wait for room
+		uint64_t start = (_txEnd > now) ? _txEnd : now;
+		_txEnd = start + _byteTime;
+		uint64_t limit = (uint64_t)(SERIAL_TX_BUFFER_SIZE + 1) * _byteTime;
+		if (_txEnd - now > limit)
+		{
+			hostAdvance(_txEnd - now - limit);
+		}
+	}
+
+	if (_peer != NULL)
+	{
+		_peer->uartByte(*this, c, _txEnd);
+	}
+	return 1;
+}
+
+size_t HostUart::write(const uint8_t *buffer, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		write(buffer[i]);
+	}
+	return size;
+}
+
+int HostUart::availableForWrite()
+{
+	uint64_t now = hostClock();
+	if (_txEnd <= now)
+	{
+		return SERIAL_TX_BUFFER_SIZE;
+	}
+	uint64_t queued = (_txEnd - now + _byteTime - 1) / _byteTime;
+	return (queued >= SERIAL_TX_BUFFER_SIZE) ? 0 : (int)(SERIAL_TX_BUFFER_SIZE - queued);
+}
@@ -0,0 +1,112 @@
+/**
+HardwareSerial.h
+
+Host build of the Arduino core - see extras/host/README.md.
+
+HostUart is one end of a simulated serial line. Bytes take 10 bit times to
+cross the line at whatever baud rate begin() was given, each direction has
+the same 64 byte buffer as the avr core (overflowing the receive buffer 
+loses bytes, just like the real thing), and write() only blocks once the 
+transmit buffer is full. The other end of the line is a HostUartPeer (see
+extras/host/sim/VirtualESP8266.h), which is handed every byte with the time 
+it finishes arriving, and answers by injecting bytes with the time it wants
+them to start.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include <stdint.h>
+#include <deque>
+
+#include "Stream.h"
+
+#ifndef SERIAL_RX_BUFFER_SIZE
+#define SERIAL_RX_BUFFER_SIZE 64
+#endif
+#ifndef SERIAL_TX_BUFFER_SIZE
+#define SERIAL_TX_BUFFER_SIZE 64
+#endif
+
+class HostUart;
+
+// whatever is on the other end of the line
+class HostUartPeer
+{
+public:
+	virtual ~HostUartPeer() {}
+
+	// a byte from us has finished arriving at [at]
+	virtual void uartByte(HostUart &uart, uint8_t c, uint64_t at) = 0;
+
+	// we are about to look at the line - anything due by [now] should be 
+	// injected
+	virtual void uartPoll(HostUart &uart, uint64_t now) { (void)uart; (void)now; }
+};
+
+class HostUart : public Stream
+{
+public:
+	// a blocking uart (SoftwareSerial) sends each byte before write() 
+	// returns, rather than buffering it
+	HostUart(bool blockingWrite);
+
+	void begin(unsigned long baud);
+	void end();
+
+	int available();
+	int read();
+	int peek();
+	void flush();
+	size_t write(uint8_t c);
+	size_t write(const uint8_t *buffer, size_t size);
+	using Print::write;
+	int availableForWrite();
+	operator bool() { return true; }
+
+	// the other end of the line
+	static void attach(HostUartPeer *peer);
+	unsigned long baud() const;
+	uint32_t byteTime() const;
+	uint64_t inject(const uint8_t *data, size_t size, uint64_t at);
+	uint64_t rxIdle() const;
+	uint32_t overruns() const;
+
+private:
+	void receive();
+
+	struct PendingByte
+	{
+		uint8_t c;
+		uint64_t at;
+	};
+
+	static HostUartPeer *_peer;
+	bool _blocking;
+	unsigned long _baud;
+	uint32_t _byteTime;
+
+	// bytes on their way to us, and the ones that have arrived
+	std::deque<PendingByte> _line;
+	uint8_t _rx[SERIAL_RX_BUFFER_SIZE];
+	uint16_t _rxHead;
+	uint16_t _rxCount;
+	uint64_t _rxEnd;
+	uint32_t _overruns;
+
+	// when the last byte we sent finishes
+	uint64_t _txEnd;
+};
+
+class HardwareSerial : public HostUart
+{
+public:
+	HardwareSerial() : HostUart(false) {}
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,58 @@
+/**
+IPAddress.h
+
+Host build of the Arduino core - see extras/host/README.md.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#ifndef IPAddress_h
+#define IPAddress_h
+
+#include <stdint.h>
+#include <string.h>
+
+class IPAddress
+{
+public:
+	IPAddress()
+	{
+		memset(_address, 0, sizeof(_address));
+	}
+	IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth)
+	{
+		_address[0] = first;
+		_address[1] = second;
+		_address[2] = third;
+		_address[3] = fourth;
+	}
+	IPAddress(uint32_t address)
+	{
+		memcpy(_address, &address, sizeof(_address));
+	}
+
+	operator uint32_t() const
+	{
+		uint32_t address;
+		memcpy(&address, _address, sizeof(address));
+		return address;
+	}
+	bool operator==(const IPAddress &addr) const
+	{
+		return memcmp(_address, addr._address, sizeof(_address)) == 0;
+	}
+	uint8_t operator[](int index) const
+	{
+		return _address[index];
+	}
+	uint8_t & operator[](int index)
+	{
+		return _address[index];
+	}
+
+private:
+	uint8_t _address[4];
+};
+
+#endif
@@ -0,0 +1,122 @@
+/**
+Print.cpp
+
+Host build of the Arduino core - see extras/host/README.md.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include <stdio.h>
+#include "Print.h"
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+	size_t n = 0;
+	while (size--)
+	{
+		if (write(*buffer++) == 0)
+		{
+			break;
+		}
+		n++;
+	}
+	return n;
+}
+
+size_t Print::write(const char *str)
+{
+	if (str == NULL)
+	{
+		return 0;
+	}
+	return write((const uint8_t *)str, strlen(str));
+}
+
+size_t Print::write(const char *buffer, size_t size)
+{
+	return write((const uint8_t *)buffer, size);
+}
+
+int Print::availableForWrite()
+{
+	return 0;
+}
+
+void Print::flush()
+{
+}
+
+size_t Print::print(const char *str)
+{
+	return write(str);
+}
+
+size_t Print::print(char c)
+{
+	return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char n, int base)
+{
+	return print((unsigned long)n, base);
+}
+
+size_t Print::print(int n, int base)
+{
+	return print((long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base)
+{
+	return print((unsigned long)n, base);
+}
+
+size_t Print::print(long n, int base)
+{
+	char str[24];
+	snprintf(str, sizeof(str), (base == HEX) ? "%lx" : "%ld", n);
+	return write(str);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+	char str[24];
+	snprintf(str, sizeof(str), (base == HEX) ? "%lx" : "%lu", n);
+	return write(str);
+}
+
+size_t Print::println()
+{
+	return write("\r\n");
+}
+
+size_t Print::println(const char *str)
+{
+	return print(str) + println();
+}
+
+size_t Print::println(char c)
+{
+	return print(c) + println();
+}
+
+size_t Print::println(int n, int base)
+{
+	return print(n, base) + println();
+}
+
+size_t Print::println(unsigned int n, int base)
+{
+	return print(n, base) + println();
+}
+
+size_t Print::println(long n, int base)
+{
+	return print(n, base) + println();
+}
+
+size_t Print::println(unsigned long n, int base)
+{
+	return print(n, base) + println();
+}
@@ -0,0 +1,51 @@
+/**
+Print.h
+
+Host build of the Arduino core - see extras/host/README.md.
+
+The subset of Print that the library (and the benchmarks) use.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#ifndef Print_h
+#define Print_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define DEC 10
+#define HEX 16
+
+class Print
+{
+public:
+	virtual ~Print() {}
+
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	size_t write(const char *str);
+	size_t write(const char *buffer, size_t size);
+	virtual int availableForWrite();
+	virtual void flush();
+
+	size_t print(const char *str);
+	size_t print(char c);
+	size_t print(unsigned char n, int base = DEC);
+	size_t print(int n, int base = DEC);
+	size_t print(unsigned int n, int base = DEC);
+	size_t print(long n, int base = DEC);
+	size_t print(unsigned long n, int base = DEC);
+
+	size_t println();
+	size_t println(const char *str);
+	size_t println(char c);
+	size_t println(int n, int base = DEC);
+	size_t println(unsigned int n, int base = DEC);
+	size_t println(long n, int base = DEC);
+	size_t println(unsigned long n, int base = DEC);
+};
+
+#endif
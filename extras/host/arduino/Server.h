@@ -0,0 +1,21 @@
+/**
+Server.h
+
+Host build of the Arduino core - see extras/host/README.md.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#ifndef Server_h
+#define Server_h
+
+#include "Print.h"
+
+class Server : public Print
+{
+public:
+	virtual void begin() = 0;
+};
+
+#endif
@@ -0,0 +1,32 @@
+/**
+SoftwareSerial.h
+
+Host build of the Arduino core - see extras/host/README.md.
+
+The pins are ignored - this is the same simulated line as Serial, but (as on
+an avr) write() waits for each byte to go.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#ifndef SoftwareSerial_h
+#define SoftwareSerial_h
+
+#include "Arduino.h"
+
+class SoftwareSerial : public HostUart
+{
+public:
+	SoftwareSerial(uint8_t receivePin, uint8_t transmitPin) : HostUart(true) 
+	{
+		(void)receivePin;
+		(void)transmitPin;
+	}
+
+	bool listen() { return false; }
+	bool isListening() { return true; }
+	bool overflow() { return overruns() > 0; }
+};
+
+#endif
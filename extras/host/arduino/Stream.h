@@ -0,0 +1,42 @@
+/**
+Stream.h
+
+Host build of the Arduino core - see extras/host/README.md.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#ifndef Stream_h
+#define Stream_h
+
+#include "Print.h"
+
+class Stream : public Print
+{
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+
+	size_t readBytes(char *buffer, size_t length)
+	{
+		size_t count = 0;
+		while (count < length)
+		{
+			int c = read();
+			if (c < 0)
+			{
+				break;
+			}
+			buffer[count++] = (char)c;
+		}
+		return count;
+	}
+	size_t readBytes(uint8_t *buffer, size_t length)
+	{
+		return readBytes((char *)buffer, length);
+	}
+};
+
+#endif
@@ -0,0 +1,394 @@
+/**
+ATESP8266Bench.cpp
+
+End to end benchmarks for the library, run against the simulated module (see
+extras/host/README.md).
+
+For each baud rate (9600, 19200 and 115200) this measures:
+
+	tx            ESP8266Client::write() until the module has all of it
+	tx_buffered   as tx, with setBufferedSend(true)
+	rx            ESP8266Client::read() of data that arrives all at once
+	tcp_connect   ESP8266Client::connect() to an ip address
+	accept        a client connecting until ESP8266Server::available() has it
+	ping          ping(), less the round trip the module reports
+
+with up to BENCH_JITTER us of (repeatable) random delay on the network side,
+and prints the 50th / 90th / 99th percentile and worst time (in simulated
+microseconds). The transfers also give bytes/sec at the median, and that as
+a fraction of what the uart can carry (baud / 10).
+
+	atesp8266_bench [--json] [--iterations <n>] [--bytes <n>] [--baud <rate>]
+
+--json prints one JSON object per line instead of a table, for keeping
+track of the numbers between releases.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include <ATESP8266WiFi.h>
+#include <VirtualESP8266.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// what to run
+static bool json = false;
+static unsigned int iterations = 20;
+static size_t transferBytes = 4096;
+static unsigned long onlyBaud = 0;
+
+static const unsigned long bauds[] = { 9600, 19200, 115200 };
+
+static const IPAddress serverIP(10, 0, 0, 1);
+static const uint16_t serverPort = 80;
+
+// how much the network side varies (so the percentiles mean something)
+#define BENCH_JITTER 5000
+
+// give up on anything that takes longer than this (simulated) time
+#define BENCH_TIMEOUT 60000000ULL
+
+////////////////
+// Reporting  //
+////////////////
+
+struct Result
+{
+	const char *test;
+	unsigned long baud;
+	std::vector<uint64_t> samples;
+	size_t bytes;			// per sample (0 for the latency tests)
+	uint32_t overruns;		// bytes lost to the uart
+	uint32_t failures;
+};
+
+static uint64_t percentile(const std::vector<uint64_t> &sorted, unsigned int p)
+{
+	if (sorted.empty())
+	{
+		return 0;
+	}
+	size_t rank = (sorted.size() * p + 99) / 100;
+	return sorted[(rank == 0) ? 0 : rank - 1];
+}
+
+static void report(Result &result)
+{
+	std::vector<uint64_t> &s = result.samples;
+	std::sort(s.begin(), s.end());
+
+	uint64_t p50 = percentile(s, 50);
+	double rate = ((result.bytes > 0) && (p50 > 0)) ? result.bytes * 1000000.0 / p50 : 0;
+	double line = rate / (result.baud / 10.0);
+
+	if (json)
+	{
+		printf("{\"test\":\"%s\",\"baud\":%lu,\"unit\":\"us\",\"n\":%u,"
+			   "\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu,"
+			   "\"bytes\":%u,\"bytes_per_sec\":%.1f,\"line_fraction\":%.4f,"
+			   "\"overruns\":%u,\"failures\":%u}\n",
+			   result.test, result.baud, (unsigned int)s.size(),
+			   (unsigned long long)p50, (unsigned long long)percentile(s, 90),
+			   (unsigned long long)percentile(s, 99),
+			   (unsigned long long)(s.empty() ? 0 : s.back()),
+			   (unsigned int)result.bytes, rate, line, result.overruns, result.failures);
+	}
+	else
+	{
+		printf("%-12s %7lu %5u %10llu %10llu %10llu %10llu", result.test, result.baud,
+			   (unsigned int)s.size(), (unsigned long long)p50,
+			   (unsigned long long)percentile(s, 90), (unsigned long long)percentile(s, 99),
+			   (unsigned long long)(s.empty() ? 0 : s.back()));
+		if (result.bytes > 0)
+		{
+			printf(" %10.1f %6.1f%%", rate, line * 100);
+		}
+		else
+		{
+			printf(" %10s %7s", "-", "-");
+		}
+		if (result.overruns || result.failures)
+		{
+			printf("  (%u overruns, %u failures)", result.overruns, result.failures);
+		}
+		printf("\n");
+	}
+	fflush(stdout);
+}
+
+static Result newResult(const char *test, unsigned long baud, size_t bytes)
+{
+	Result result;
+	result.test = test;
+	result.baud = baud;
+	result.bytes = bytes;
+	result.overruns = 0;
+	result.failures = 0;
+	return result;
+}
+
+///////////////
+// The Tests //
+///////////////
+
+// wait until [done] or the time runs out
+template <typename F>
+static bool waitFor(F done)
+{
+	uint64_t start = hostClock();
+	while (!done())
+	{
+		if (hostClock() - start > BENCH_TIMEOUT)
+		{
+			return false;
+		}
+		esp8266.poll();
+	}
+	return true;
+}
+
+static void benchSend(VirtualESP8266 &esp, unsigned long baud, bool buffered)
+{
+	Result result = newResult(buffered ? "tx_buffered" : "tx", baud, transferBytes);
+	std::vector<uint8_t> data(transferBytes, 'x');
+
+	size_t received = 0;
+	uint64_t last = 0;
+	esp.onData([&](uint8_t link, const uint8_t *buf, size_t size, uint64_t at)
+	{
+		(void)link;
+		(void)buf;
+		received += size;
+		last = at;
+	});
+
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		ESP8266Client client;
+		if (client.connect(serverIP, serverPort) <= 0)
+		{
+			result.failures++;
+			continue;
+		}
+		client.setBufferedSend(buffered);
+
+		// from the first write to the last byte reaching the module
+		received = 0;
+		uint64_t start = hostClock();
+		size_t written = client.write(data.data(), data.size());
+		client.flush();
+		if ((written != data.size()) || !waitFor([&] { return received >= data.size(); }))
+		{
+			result.failures++;
+		}
+		else
+		{
+			result.samples.push_back(last - start);
+		}
+
+		// let the acks come in before the next one
+		waitFor([&] { return hostClock() >= esp.idle(); });
+		client.stop();
+	}
+
+	esp.onData(NULL);
+	report(result);
+}
+
+static void benchReceive(VirtualESP8266 &esp, unsigned long baud)
+{
+	Result result = newResult("rx", baud, transferBytes);
+	std::vector<uint8_t> data(transferBytes, 'r');
+	std::vector<uint8_t> buf(256);
+	uint32_t overruns = esp.uart().overruns();
+
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		ESP8266Client client;
+		if (client.connect(serverIP, serverPort) <= 0)
+		{
+			result.failures++;
+			continue;
+		}
+
+		// the server sends it all at once, and we read it as fast as we can
+		uint8_t link = ESP8266_SOCK_NOT_AVAIL;
+		for (uint8_t j = 0; j < VIRTUAL_ESP8266_LINKS; j++)
+		{
+			if (esp.link(j).open && !esp.link(j).server)
+			{
+				link = j;
+			}
+		}
+		uint64_t start = hostClock();
+		esp.deliver(link, data.data(), data.size());
+
+		size_t received = 0;
+		uint64_t end = start;
+		bool done = waitFor([&]
+		{
+			int n = client.read(buf.data(), buf.size());
+			if (n > 0)
+			{
+				received += n;
+				end = hostClock();
+			}
+			// (anything lost to an overrun is never coming)
+			return (received >= data.size()) || (hostClock() > esp.idle() + 1000000);
+		});
+
+		if (!done || (received < data.size()))
+		{
+			result.failures++;
+		}
+		else
+		{
+			result.samples.push_back(end - start);
+		}
+		client.stop();
+	}
+
+	result.overruns = esp.uart().overruns() - overruns;
+	report(result);
+}
+
+static void benchConnect(unsigned long baud)
+{
+	Result result = newResult("tcp_connect", baud, 0);
+
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		ESP8266Client client;
+		uint64_t start = hostClock();
+		if (client.connect(serverIP, serverPort) <= 0)
+		{
+			result.failures++;
+		}
+		else
+		{
+			result.samples.push_back(hostClock() - start);
+		}
+		client.stop();
+	}
+
+	report(result);
+}
+
+static void benchAccept(VirtualESP8266 &esp, unsigned long baud)
+{
+	Result result = newResult("accept", baud, 0);
+
+	ESP8266Server server(serverPort);
+	server.begin();
+
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		uint64_t start = hostClock();
+		if (esp.acceptConnection(IPAddress(10, 0, 0, 9), 50000 + i) < 0)
+		{
+			result.failures++;
+			continue;
+		}
+
+		ESP8266Client client;
+		if (!waitFor([&] { client = server.available(); return (bool)client; }))
+		{
+			result.failures++;
+			continue;
+		}
+		result.samples.push_back(hostClock() - start);
+		client.stop();
+	}
+
+	report(result);
+}
+
+static void benchPing(unsigned long baud)
+{
+	Result result = newResult("ping", baud, 0);
+
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		uint64_t start = hostClock();
+		int16_t rtt = esp8266.ping(serverIP);
+		if (rtt <= 0)
+		{
+			result.failures++;
+			continue;
+		}
+		result.samples.push_back(hostClock() - start - rtt * 1000ULL);
+	}
+
+	report(result);
+}
+
+static void runBaud(unsigned long baud)
+{
+	// a fresh module (and uart) for every baud rate
+	Serial.end();
+	VirtualESP8266 esp;
+	esp.timing.jitter = BENCH_JITTER;
+	if (!esp8266.begin(baud, ESP8266_HARDWARE_SERIAL))
+	{
+		fprintf(stderr, "begin() failed at %lu baud\n", baud);
+		return;
+	}
+
+	benchSend(esp, baud, false);
+	benchSend(esp, baud, true);
+	benchReceive(esp, baud);
+	benchConnect(baud);
+	benchAccept(esp, baud);
+	benchPing(baud);
+}
+
+int main(int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--json")
+		{
+			json = true;
+		}
+		else if ((arg == "--iterations") && (i + 1 < argc))
+		{
+			iterations = strtoul(argv[++i], NULL, 10);
+		}
+		else if ((arg == "--bytes") && (i + 1 < argc))
+		{
+			transferBytes = strtoul(argv[++i], NULL, 10);
+		}
+		else if ((arg == "--baud") && (i + 1 < argc))
+		{
+			onlyBaud = strtoul(argv[++i], NULL, 10);
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--json] [--iterations <n>] [--bytes <n>] [--baud <rate>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (!json)
+	{
+		printf("%-12s %7s %5s %10s %10s %10s %10s %10s %7s\n", "test", "baud", "n",
+			   "p50 us", "p90 us", "p99 us", "max us", "bytes/s", "line");
+	}
+
+	for (size_t i = 0; i < sizeof(bauds) / sizeof(bauds[0]); i++)
+	{
+		if ((onlyBaud == 0) || (onlyBaud == bauds[i]))
+		{
+			runBaud(bauds[i]);
+		}
+	}
+	if ((onlyBaud != 0) && (std::find(bauds, bauds + 3, onlyBaud) == bauds + 3))
+	{
+		runBaud(onlyBaud);
+	}
+	return 0;
+}
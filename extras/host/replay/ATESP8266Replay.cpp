@@ -0,0 +1,218 @@
+/**
+ATESP8266Replay.cpp
+
+Plays a uart trace (see src/ATESP8266Trace.h) back through the library on
+the host, to see how the parser copes with it and how long it takes:
+
+	atesp8266_replay [--speed <n>] <trace file>
+
+--speed 1 (the default) plays it at the speed it was recorded, 2 twice as
+fast and so on, and 0 as fast as the parser will take it. A trace can come
+from esp8266.trace().dump() on a board, or from a session with the simulated
+module:
+
+	atesp8266_replay --capture <trace file> [--baud <rate>]
+
+(which connects, sends, receives and pings).
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include <ATESP8266WiFi.h>
+#include <VirtualESP8266.h>
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// a Print that goes to a file
+class FilePrint : public Print
+{
+public:
+	FilePrint(FILE *file) : _file(file) {}
+
+	size_t write(uint8_t c)
+	{
+		return (fputc(c, _file) == EOF) ? 0 : 1;
+	}
+
+	size_t write(const uint8_t *buffer, size_t size)
+	{
+		return fwrite(buffer, 1, size, _file);
+	}
+
+private:
+	FILE *_file;
+};
+
+static int capture(const char *path, unsigned long baud)
+{
+	VirtualESP8266 esp;
+	if (!esp8266.begin(baud, ESP8266_HARDWARE_SERIAL))
+	{
+		fprintf(stderr, "begin() failed at %lu baud\n", baud);
+		return 1;
+	}
+	esp8266.trace().clear();
+
+	// a request and its response
+	ESP8266Client client;
+	if (client.connect(IPAddress(10, 0, 0, 1), 80) <= 0)
+	{
+		fprintf(stderr, "connect() failed\n");
+		return 1;
+	}
+	client.print("GET / HTTP/1.0\r\n\r\n");
+
+	std::string page = "HTTP/1.0 200 OK\r\n\r\n" + std::string(2048, 'x');
+	uint8_t link = 0;
+	for (uint8_t i = 0; i < VIRTUAL_ESP8266_LINKS; i++)
+	{
+		if (esp.link(i).open)
+		{
+			link = i;
+		}
+	}
+	esp.deliver(link, page.data(), page.size());
+	size_t received = 0;
+	uint64_t start = hostClock();
+	while ((received < page.size()) && (hostClock() - start < 10000000))
+	{
+		uint8_t buf[128];
+		int n = client.read(buf, sizeof(buf));
+		if (n > 0)
+		{
+			received += n;
+		}
+	}
+	client.stop();
+	esp8266.ping(IPAddress(10, 0, 0, 1));
+
+	FILE *file = fopen(path, "wb");
+	if (file == NULL)
+	{
+		perror(path);
+		return 1;
+	}
+	FilePrint out(file);
+	size_t written = esp8266.trace().dump(out);
+	fclose(file);
+
+	printf("%u records (%lu lost), %u bytes, %u bytes of payload read\n",
+		   (unsigned int)esp8266.trace().available(), esp8266.trace().lost(),
+		   (unsigned int)written, (unsigned int)received);
+	return 0;
+}
+
+static bool load(const char *path, std::vector<esp8266_trace_record> &records)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		perror(path);
+		return false;
+	}
+
+	uint8_t header[8];
+	if ((fread(header, 1, sizeof(header), file) != sizeof(header)) ||
+		(memcmp(header, "ESPT", 4) != 0) || (header[4] != ESP8266_TRACE_VERSION))
+	{
+		fprintf(stderr, "%s: not a version %d trace\n", path, ESP8266_TRACE_VERSION);
+		fclose(file);
+		return false;
+	}
+
+	size_t count = header[6] | (header[7] << 8);
+	for (size_t i = 0; i < count; i++)
+	{
+		uint8_t bytes[4];
+		if (fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes))
+		{
+			fprintf(stderr, "%s: only %u of %u records\n", path, (unsigned int)i, (unsigned int)count);
+			break;
+		}
+		esp8266_trace_record r;
+		r.delta = bytes[0] | (bytes[1] << 8);
+		r.type = bytes[2];
+		r.c = bytes[3];
+		records.push_back(r);
+	}
+	fclose(file);
+	return true;
+}
+
+static int replay(const char *path, uint8_t speed)
+{
+	std::vector<esp8266_trace_record> records;
+	if (!load(path, records))
+	{
+		return 1;
+	}
+
+	size_t rx = 0;
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		rx += (records[i].type == ESP8266_TRACE_RX);
+	}
+
+	ESP8266TraceReplay player;
+	player.begin(records.data(), records.size(), speed);
+	player.run();
+
+	printf("records    %u (%u received)\n", (unsigned int)records.size(), (unsigned int)rx);
+	printf("commands   %u (%u passed, %u failed, %u timed out)\n", player.commands(),
+		   player.passed(), player.failed(), player.timedOut());
+	printf("parsed     %lu bytes (%lu of +IPD payload)\n", player.received(), player.payload());
+	printf("recorded   %lu us\n", player.recorded());
+	printf("replayed   %lu us\n", player.elapsed());
+	return (player.received() == rx) ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = NULL;
+	const char *capturePath = NULL;
+	unsigned long baud = 115200;
+	uint8_t speed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if ((arg == "--capture") && (i + 1 < argc))
+		{
+			capturePath = argv[++i];
+		}
+		else if ((arg == "--baud") && (i + 1 < argc))
+		{
+			baud = strtoul(argv[++i], NULL, 10);
+		}
+		else if ((arg == "--speed") && (i + 1 < argc))
+		{
+			speed = strtoul(argv[++i], NULL, 10);
+		}
+		else if ((path == NULL) && (arg[0] != '-'))
+		{
+			path = argv[i];
+		}
+		else
+		{
+			path = NULL;
+			capturePath = NULL;
+			break;
+		}
+	}
+
+	if (capturePath != NULL)
+	{
+		return capture(capturePath, baud);
+	}
+	if (path != NULL)
+	{
+		return replay(path, speed);
+	}
+
+	fprintf(stderr, "usage: %s [--speed <n>] <trace file>\n"
+					"       %s --capture <trace file> [--baud <rate>]\n", argv[0], argv[0]);
+	return 1;
+}
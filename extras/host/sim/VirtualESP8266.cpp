@@ -0,0 +1,951 @@
+/**
+VirtualESP8266.cpp
+
+A simulated ESP8266 running the AT firmware. See VirtualESP8266.h for
+details.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "VirtualESP8266.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+VirtualESP8266::VirtualESP8266()
+{
+	// roughly what a module on a quiet network does
+	timing.command = 500;
+	timing.connect = 30000;
+	timing.sendAck = 10000;
+	timing.ping = 12000;
+	timing.dns = 20000;
+	timing.join = 2000000;
+	timing.packetGap = 20000;
+	timing.jitter = 0;
+	_random = 1;
+
+	_uart = &Serial;
+	_busyReplies = 0;
+	_dataHandler = NULL;
+	_joined = true;
+	reset(0);
+
+	// (and it has already booted)
+	_pending.clear();
+	_busyUntil = 0;
+
+	HostUart::attach(this);
+}
+
+VirtualESP8266::~VirtualESP8266()
+{
+	HostUart::attach(NULL);
+}
+
+////////////////
+// Scripting  //
+////////////////
+
+// answer commands starting with [prefix] with [handler] (tried before the
+// built in commands, and in the order they were added)
+void VirtualESP8266::onCommand(const char *prefix, CommandHandler handler)
+{
+	Handler h = { prefix, handler };
+	_handlers.push_back(h);
+}
+
+// [handler] gets the payload of every send
+void VirtualESP8266::onData(DataHandler handler)
+{
+	_dataHandler = handler;
+}
+
+// what AT+CIPDOMAIN (and AT+CIPSTART / AT+PING) will find [name] at
+void VirtualESP8266::addHost(const char *name, IPAddress ip)
+{
+	Host host = { name, ip };
+	_hosts.push_back(host);
+}
+
+// connections to [ip]:[port] will fail
+void VirtualESP8266::refuse(IPAddress ip, uint16_t port)
+{
+	_refused.push_back(std::make_pair((uint32_t)ip, port));
+}
+
+// whether the module is on the network (it starts out joined)
+void VirtualESP8266::setJoined(bool joined)
+{
+	_joined = joined;
+	_status = joined ? 2 : 5;
+}
+
+//////////////////
+// Network Side //
+//////////////////
+
+// a client connects to our server - returns the link it got, or -1 if the
+// server isn't running or there are no links free
+int VirtualESP8266::acceptConnection(IPAddress ip, uint16_t port, uint64_t at)
+{
+	if ((_serverPort == 0) || !_mux)
+	{
+		return -1;
+	}
+
+	for (uint8_t i = 0; i < VIRTUAL_ESP8266_LINKS; i++)
+	{
+		if (!_links[i].open)
+		{
+			Link &l = _links[i];
+			l = Link();
+			l.open = true;
+			l.server = true;
+			l.remoteIP = ip;
+			l.remotePort = port;
+			l.localPort = _serverPort;
+			l.opened = now(at);
+
+			char text[16];
+			sprintf(text, "%u,CONNECT\r\n", i);
+			respond(text, at);
+			_status = 3;
+			return i;
+		}
+	}
+	return -1;
+}
+
+// the far end of [link] sends us some data - it is split into segments, and
+// each one turns up as its own +IPD
+void VirtualESP8266::deliver(uint8_t link, const void *data, size_t size, uint64_t at)
+{
+	if (link >= VIRTUAL_ESP8266_LINKS)
+	{
+		return;
+	}
+	deliverFrom(link, _links[link].remoteIP, _links[link].remotePort, data, size, at);
+}
+
+void VirtualESP8266::deliverFrom(uint8_t link, IPAddress ip, uint16_t port, const void *data, size_t size, uint64_t at)
+{
+	if ((link >= VIRTUAL_ESP8266_LINKS) || !_links[link].open)
+	{
+		return;
+	}
+
+	const char *p = (const char *)data;
+	_links[link].bytesOut += size;
+
+	// in passthrough mode it is just the data
+	if (_state == PASSTHROUGH)
+	{
+		schedule(now(at), std::string(p, size));
+		return;
+	}
+
+	do
+	{
+		size_t len = (size > VIRTUAL_ESP8266_SEGMENT) ? VIRTUAL_ESP8266_SEGMENT : size;
+
+		char header[64];
+		if (!_mux)
+		{
+			sprintf(header, "\r\n+IPD,%u:", (unsigned int)len);
+		}
+		else if (_dataInfo)
+		{
+			sprintf(header, "\r\n+IPD,%u,%u,%u.%u.%u.%u,%u:", link, (unsigned int)len,
+					ip[0], ip[1], ip[2], ip[3], port);
+		}
+		else
+		{
+			sprintf(header, "\r\n+IPD,%u,%u:", link, (unsigned int)len);
+		}
+
+		schedule(now(at), std::string(header) + std::string(p, len));
+		p += len;
+		size -= len;
+	} while (size > 0);
+}
+
+// the far end of [link] hangs up
+void VirtualESP8266::closeLink(uint8_t link, uint64_t at)
+{
+	if ((link >= VIRTUAL_ESP8266_LINKS) || !_links[link].open)
+	{
+		return;
+	}
+
+	_links[link].open = false;
+	char text[16];
+	if (_mux)
+	{
+		sprintf(text, "%u,CLOSED\r\n", link);
+	}
+	else
+	{
+		sprintf(text, "CLOSED\r\n");
+	}
+	respond(text, at);
+}
+
+// say [text] at [at] (after anything already due by then) - returns when
+// it starts
+uint64_t VirtualESP8266::respond(const char *text, uint64_t at)
+{
+	at = now(at);
+	schedule(at, text);
+	return at;
+}
+
+//////////////////////
+// What's Happened  //
+//////////////////////
+
+const VirtualESP8266::Link & VirtualESP8266::link(uint8_t linkID) const
+{
+	return _links[linkID % VIRTUAL_ESP8266_LINKS];
+}
+
+// every command we have been sent (with when it finished arriving)
+const std::vector<VirtualESP8266::Command> & VirtualESP8266::commands() const
+{
+	return _commands;
+}
+
+// commands turned away because we were still working on the last one
+uint32_t VirtualESP8266::busyReplies() const
+{
+	return _busyReplies;
+}
+
+// when we will have finished saying everything we are going to say
+uint64_t VirtualESP8266::idle() const
+{
+	uint64_t end = _uart->rxIdle();
+	for (size_t i = 0; i < _pending.size(); i++)
+	{
+		uint64_t done = _pending[i].at + (uint64_t)_pending[i].text.size() * _uart->byteTime();
+		if (done > end)
+		{
+			end = done;
+		}
+	}
+	return end;
+}
+
+void VirtualESP8266::clearLog()
+{
+	_commands.clear();
+	_busyReplies = 0;
+}
+
+HostUart & VirtualESP8266::uart()
+{
+	return *_uart;
+}
+
+//////////////
+// The Uart //
+//////////////
+
+// put everything that is due by [now] on the line
+void VirtualESP8266::uartPoll(HostUart &uart, uint64_t now)
+{
+	if (&uart != _uart)
+	{
+		return;
+	}
+
+	size_t due = 0;
+	while ((due < _pending.size()) && (_pending[due].at <= now))
+	{
+		const std::string &text = _pending[due].text;
+		uart.inject((const uint8_t *)text.data(), text.size(), _pending[due].at);
+		due++;
+	}
+	_pending.erase(_pending.begin(), _pending.begin() + due);
+}
+
+void VirtualESP8266::uartByte(HostUart &uart, uint8_t c, uint64_t at)
+{
+	// answer on whichever uart the library is using
+	_uart = &uart;
+
+	switch (_state)
+	{
+	case PAYLOAD:
+		_payload.push_back(c);
+		if (--_payloadLeft == 0)
+		{
+			payloadDone(at);
+		}
+		break;
+
+	case PASSTHROUGH:
+		passthroughByte(c, at);
+		break;
+
+	default:
+		if (_echo)
+		{
+			char echo[2] = { (char)c, '\0' };
+			respond(echo, at);
+		}
+		if (c == '\n')
+		{
+			if (!_line.empty() && (_line[_line.size() - 1] == '\r'))
+			{
+				_line.erase(_line.size() - 1);
+			}
+			if (!_line.empty())
+			{
+				command(_line, at);
+			}
+			_line.clear();
+		}
+		else
+		{
+			_line.push_back(c);
+		}
+		break;
+	}
+}
+
+//////////////
+// Commands //
+//////////////
+
+void VirtualESP8266::command(const std::string &text, uint64_t at)
+{
+	Command cmd = { at, text };
+	_commands.push_back(cmd);
+
+	// the firmware only does one thing at a time
+	if (at < _busyUntil)
+	{
+		respond("busy p...\r\n", at);
+		_busyReplies++;
+		return;
+	}
+
+	for (size_t i = 0; i < _handlers.size(); i++)
+	{
+		if ((text.compare(0, _handlers[i].prefix.size(), _handlers[i].prefix) == 0) &&
+			_handlers[i].handler(*this, text, at))
+		{
+			return;
+		}
+	}
+
+	if (text.compare(0, 2, "AT") != 0)
+	{
+		respond("\r\nERROR\r\n", at + timing.command);
+		return;
+	}
+
+	// AT<name>, AT<name>? or AT<name>=<args>
+	std::string name = text.substr(2);
+	char kind = '\0';
+	std::vector<std::string> args;
+	size_t split = name.find_first_of("=?");
+	if (split != std::string::npos)
+	{
+		kind = name[split];
+		std::string params = name.substr(split + 1);
+		name.erase(split);
+
+		// comma separated, with strings in quotes
+		std::string arg;
+		bool quoted = false;
+		for (size_t i = 0; i < params.size(); i++)
+		{
+			char c = params[i];
+			if (c == '"')
+			{
+				quoted = !quoted;
+			}
+			else if ((c == ',') && !quoted)
+			{
+				args.push_back(arg);
+				arg.clear();
+			}
+			else
+			{
+				arg.push_back(c);
+			}
+		}
+		args.push_back(arg);
+	}
+
+	// v1.x has _DEF and _CUR versions of the settings, v2.0 doesn't
+	if ((name.size() > 4) &&
+		((name.compare(name.size() - 4, 4, "_DEF") == 0) || (name.compare(name.size() - 4, 4, "_CUR") == 0)))
+	{
+		name.erase(name.size() - 4);
+	}
+
+	if (!builtIn(name, kind, args, at))
+	{
+		respond("\r\nERROR\r\n", at + timing.command);
+	}
+}
+
+bool VirtualESP8266::builtIn(const std::string &name, char kind, const std::vector<std::string> &args, uint64_t at)
+{
+	uint64_t t = at + timing.command;
+	const char *ok = "\r\nOK\r\n";
+	char text[128];
+
+	// basic commands
+	if (name.empty() || (name == "+UART") || (name == "+CWDHCP") ||
+		(name == "+CIPSTO") || (name == "+CIPSSLSIZE"))
+	{
+		respond(ok, t);
+	}
+	else if ((name == "E0") || (name == "E1"))
+	{
+		_echo = (name == "E1");
+		respond(ok, t);
+	}
+	else if (name == "+RST")
+	{
+		respond(ok, t);
+		reset(t);
+	}
+	else if (name == "+GMR")
+	{
+		respond("AT version:1.3.0.0(Jul 14 2016 18:54:01)\r\n"
+				"SDK version:2.0.0(656edbf)\r\n"
+				"compile time:host build\r\n\r\nOK\r\n", t);
+	}
+
+	// wifi
+	else if (name == "+CWMODE")
+	{
+		respond((kind == '?') ? "+CWMODE_DEF:1\r\n\r\nOK\r\n" : ok, t);
+	}
+	else if (name == "+CWJAP")
+	{
+		if (kind == '?')
+		{
+			respond(_joined ? "+CWJAP_DEF:\"virtual\",\"18:fe:34:00:00:02\",6,-50\r\n\r\nOK\r\n" :
+					"No AP\r\n\r\nOK\r\n", t);
+		}
+		else
+		{
+			_busyUntil = at + timing.join;
+			respond("WIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n", _busyUntil);
+			setJoined(true);
+		}
+	}
+	else if (name == "+CWQAP")
+	{
+		respond(ok, t);
+		for (uint8_t i = 0; i < VIRTUAL_ESP8266_LINKS; i++)
+		{
+			closeLink(i, t);
+		}
+		respond("WIFI DISCONNECT\r\n", t + timing.command);
+		setJoined(false);
+	}
+	else if (name == "+CWLAP")
+	{
+		respond("+CWLAP:(3,\"virtual\",-50,\"18:fe:34:00:00:02\",6)\r\n\r\nOK\r\n", t);
+	}
+	else if (name == "+CIPSTAMAC")
+	{
+		respond((kind == '?') ? "+CIPSTAMAC_DEF:\"18:fe:34:00:00:01\"\r\n\r\nOK\r\n" : ok, t);
+	}
+	else if (name == "+CIFSR")
+	{
+		respond(_joined ? "+CIFSR:STAIP,\"10.0.0.2\"\r\n+CIFSR:STAMAC,\"18:fe:34:00:00:01\"\r\n\r\nOK\r\n" :
+				"+CIFSR:STAIP,\"0.0.0.0\"\r\n+CIFSR:STAMAC,\"18:fe:34:00:00:01\"\r\n\r\nOK\r\n", t);
+	}
+
+	// tcp/ip settings
+	else if (name == "+CIPSTATUS")
+	{
+		status(t);
+	}
+	else if (name == "+CIPMUX")
+	{
+		if (kind == '?')
+		{
+			respond(_mux ? "+CIPMUX:1\r\n\r\nOK\r\n" : "+CIPMUX:0\r\n\r\nOK\r\n", t);
+			return true;
+		}
+		for (uint8_t i = 0; i < VIRTUAL_ESP8266_LINKS; i++)
+		{
+			if (_links[i].open)
+			{
+				respond("link is builded\r\n\r\nERROR\r\n", t);
+				return true;
+			}
+		}
+		_mux = !args.empty() && (atoi(args[0].c_str()) == 1);
+		respond(ok, t);
+	}
+	else if (name == "+CIPMODE")
+	{
+		_passthroughMode = !args.empty() && (atoi(args[0].c_str()) == 1);
+		respond(ok, t);
+	}
+	else if (name == "+CIPDINFO")
+	{
+		_dataInfo = !args.empty() && (atoi(args[0].c_str()) == 1);
+		respond(ok, t);
+	}
+	else if (name == "+CIPSERVER")
+	{
+		if (!_mux || args.empty())
+		{
+			return false;
+		}
+		_serverPort = (atoi(args[0].c_str()) == 1) ? ((args.size() > 1) ? atoi(args[1].c_str()) : 333) : 0;
+		respond(ok, t);
+	}
+
+	// connections
+	else if (name == "+CIPSTART")
+	{
+		start(args, at);
+	}
+	else if ((name == "+CIPSEND") && (kind == '\0'))
+	{
+		// passthrough - everything from now on goes to the server
+		if (!_passthroughMode || _mux || !_links[0].open)
+		{
+			return false;
+		}
+		respond("\r\nOK\r\n\r\n>", t);
+		_state = PASSTHROUGH;
+		_lastByte = at;
+		_plus = 0;
+	}
+	else if ((name == "+CIPSEND") || (name == "+CIPSENDBUF"))
+	{
+		send(args, (name == "+CIPSENDBUF"), at);
+	}
+	else if (name == "+CIPBUFSTATUS")
+	{
+		if (args.empty() || (atoi(args[0].c_str()) >= VIRTUAL_ESP8266_LINKS))
+		{
+			return false;
+		}
+		bufferStatus(atoi(args[0].c_str()), at);
+	}
+	else if (name == "+CIPCLOSE")
+	{
+		close(args.empty() ? (_mux ? -1 : 0) : atoi(args[0].c_str()), at);
+	}
+
+	// the network
+	else if ((name == "+PING") || (name == "+CIPDOMAIN"))
+	{
+		IPAddress ip;
+		if (args.empty() || !lookup(args[0], ip))
+		{
+			_busyUntil = at + network(timing.dns);
+			respond((name == "+PING") ? "+timeout\r\n\r\nERROR\r\n" : "DNS Fail\r\n\r\nERROR\r\n", _busyUntil);
+		}
+		else if (name == "+PING")
+		{
+			_busyUntil = at + timing.ping;
+			sprintf(text, "+%u\r\n\r\nOK\r\n", (unsigned int)(timing.ping / 1000));
+			respond(text, _busyUntil);
+		}
+		else
+		{
+			_busyUntil = at + network(timing.dns);
+			sprintf(text, "+CIPDOMAIN:%u.%u.%u.%u\r\n\r\nOK\r\n", ip[0], ip[1], ip[2], ip[3]);
+			respond(text, _busyUntil);
+		}
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+// AT+CIPSTART=[<link ID>,]<type>,<remote ip>,<remote port>[,<keep alive> |
+// ,<local port>,<mode>]
+void VirtualESP8266::start(const std::vector<std::string> &args, uint64_t at)
+{
+	uint64_t t = at + timing.command;
+
+	size_t next = 0;
+	int id = linkArg(args, next);
+	if ((id < 0) || (args.size() < next + 3))
+	{
+		respond("\r\nERROR\r\n", t);
+		return;
+	}
+
+	Link &l = _links[id];
+	if (l.open)
+	{
+		respond("ALREADY CONNECTED\r\n\r\nERROR\r\n", t);
+		return;
+	}
+
+	// looking a name up takes a while, and might not work
+	IPAddress ip;
+	const std::string &host = args[next + 1];
+	bool named = (host.find_first_not_of("0123456789.") != std::string::npos);
+	if (named)
+	{
+		t += network(timing.dns);
+	}
+	if (!lookup(host, ip))
+	{
+		_busyUntil = t;
+		respond("DNS Fail\r\n\r\nERROR\r\n", t);
+		return;
+	}
+
+	bool udp = (args[next] == "UDP");
+	uint16_t port = atoi(args[next + 2].c_str());
+	if (!udp)
+	{
+		t += network(timing.connect);
+	}
+	_busyUntil = t;
+
+	char prefix[4] = "";
+	if (_mux)
+	{
+		sprintf(prefix, "%d,", id);
+	}
+	std::string reply = prefix;
+
+	for (size_t i = 0; i < _refused.size(); i++)
+	{
+		if (!udp && (_refused[i].first == (uint32_t)ip) && (_refused[i].second == port))
+		{
+			respond((reply + "CLOSED\r\n\r\nERROR\r\n").c_str(), t);
+			return;
+		}
+	}
+
+	l = Link();
+	l.open = true;
+	l.udp = udp;
+	l.remoteIP = ip;
+	l.remotePort = port;
+	l.localPort = (udp && (args.size() > next + 3)) ? atoi(args[next + 3].c_str()) : 0;
+	l.opened = t;
+	_nextSegment[id] = 0;
+	_ackedSegment[id] = 0;
+	_segments[id].clear();
+	_status = 3;
+
+	respond((reply + "CONNECT\r\n\r\nOK\r\n").c_str(), t);
+}
+
+// AT+CIPSEND=[<link ID>,]<length>[,<remote ip>,<remote port>] or
+// AT+CIPSENDBUF=[<link ID>,]<length>
+void VirtualESP8266::send(const std::vector<std::string> &args, bool buffered, uint64_t at)
+{
+	uint64_t t = at + timing.command;
+
+	size_t next = 0;
+	int id = linkArg(args, next);
+	if ((id < 0) || (args.size() < next + 1))
+	{
+		respond("\r\nERROR\r\n", t);
+		return;
+	}
+	if (!_links[id].open)
+	{
+		respond("link is not valid\r\n\r\nERROR\r\n", t);
+		return;
+	}
+
+	int len = atoi(args[next].c_str());
+	if ((len <= 0) || (len > 2048) || (buffered && _links[id].udp))
+	{
+		respond("\r\nERROR\r\n", t);
+		return;
+	}
+
+	_payloadLink = id;
+	_payloadLen = len;
+	_payloadLeft = len;
+	_payloadBuffered = buffered;
+	_payload.clear();
+	_links[id].sends++;
+	_state = PAYLOAD;
+
+	if (buffered)
+	{
+		// the segment ID comes before the prompt
+		char text[32];
+		sprintf(text, "%u,%u\r\n\r\nOK\r\n> ", (unsigned int)(++_nextSegment[id]), (unsigned int)len);
+		respond(text, t);
+	}
+	else
+	{
+		respond("\r\nOK\r\n> ", t);
+	}
+}
+
+// the payload of a send has all arrived
+void VirtualESP8266::payloadDone(uint64_t at)
+{
+	_state = COMMAND;
+	data(_payloadLink, (const uint8_t *)_payload.data(), _payload.size(), at);
+
+	uint64_t t = at + timing.command;
+	char text[32];
+	sprintf(text, "\r\nRecv %u bytes\r\n", (unsigned int)_payloadLen);
+	respond(text, t);
+
+	uint64_t acked = at + network(timing.sendAck);
+	if (acked < t)
+	{
+		acked = t;
+	}
+
+	if (_payloadBuffered)
+	{
+		// the ack turns up whenever it turns up, and we can carry on
+		uint8_t id = _payloadLink;
+		Segment segment = { _nextSegment[id], _payloadLen, acked };
+		_segments[id].push_back(segment);
+		sprintf(text, "%u,%u,SEND OK\r\n", id, (unsigned int)segment.id);
+		respond(text, acked);
+	}
+	else
+	{
+		// nothing else gets done until the server has it
+		_busyUntil = acked;
+		respond("\r\nSEND OK\r\n", acked);
+	}
+}
+
+// AT+CIPBUFSTATUS=<link ID>
+void VirtualESP8266::bufferStatus(uint8_t link, uint64_t at)
+{
+	// everything acked by now is out of the buffer
+	std::vector<Segment> &segments = _segments[link];
+	uint32_t queued = 0;
+	size_t acked = 0;
+	while ((acked < segments.size()) && (segments[acked].acked <= at))
+	{
+		_ackedSegment[link] = segments[acked].id;
+		acked++;
+	}
+	segments.erase(segments.begin(), segments.begin() + acked);
+	for (size_t i = 0; i < segments.size(); i++)
+	{
+		queued += segments[i].length;
+	}
+
+	char text[96];
+	sprintf(text, "+CIPBUFSTATUS:%u,%u,%u,%u,%u\r\n\r\nOK\r\n",
+			(unsigned int)(_nextSegment[link] + 1), (unsigned int)_nextSegment[link],
+			(unsigned int)_ackedSegment[link],
+			(unsigned int)((queued < VIRTUAL_ESP8266_WINDOW) ? VIRTUAL_ESP8266_WINDOW - queued : 0),
+			(unsigned int)segments.size());
+	respond(text, at + timing.command);
+}
+
+// AT+CIPCLOSE=<link ID> (5 or -1 closes them all)
+void VirtualESP8266::close(int link, uint64_t at)
+{
+	uint64_t t = at + timing.command;
+	if ((link < 0) || (link >= VIRTUAL_ESP8266_LINKS))
+	{
+		for (uint8_t i = 0; i < VIRTUAL_ESP8266_LINKS; i++)
+		{
+			closeLink(i, t);
+		}
+		_status = _joined ? 4 : 5;
+		respond("\r\nOK\r\n", t);
+		return;
+	}
+
+	if (!_links[link].open)
+	{
+		respond("\r\nERROR\r\n", t);
+		return;
+	}
+	closeLink(link, t);
+	respond("\r\nOK\r\n", t);
+
+	_status = _joined ? 4 : 5;
+	for (uint8_t i = 0; i < VIRTUAL_ESP8266_LINKS; i++)
+	{
+		if (_links[i].open)
+		{
+			_status = 3;
+		}
+	}
+}
+
+// AT+CIPSTATUS
+void VirtualESP8266::status(uint64_t at)
+{
+	char text[96];
+	sprintf(text, "STATUS:%u\r\n", _status);
+	std::string reply = text;
+
+	for (uint8_t i = 0; i < VIRTUAL_ESP8266_LINKS; i++)
+	{
+		const Link &l = _links[i];
+		if (l.open)
+		{
+			sprintf(text, "+CIPSTATUS:%u,\"%s\",\"%u.%u.%u.%u\",%u,%u,%u\r\n", i,
+					l.udp ? "UDP" : "TCP", l.remoteIP[0], l.remoteIP[1], l.remoteIP[2],
+					l.remoteIP[3], l.remotePort, l.localPort, l.server ? 1 : 0);
+			reply += text;
+		}
+	}
+	reply += "\r\nOK\r\n";
+	respond(reply.c_str(), at);
+}
+
+// power up (or AT+RST)
+void VirtualESP8266::reset(uint64_t at)
+{
+	for (uint8_t i = 0; i < VIRTUAL_ESP8266_LINKS; i++)
+	{
+		_links[i] = Link();
+		_nextSegment[i] = 0;
+		_ackedSegment[i] = 0;
+		_segments[i].clear();
+	}
+
+	_state = COMMAND;
+	_line.clear();
+	_echo = true;
+	_mux = false;
+	_passthroughMode = false;
+	_dataInfo = false;
+	_serverPort = 0;
+	_status = _joined ? 2 : 5;
+	_lastByte = 0;
+	_plus = 0;
+
+	// the boot messages come out at 74880 baud, so they are just noise here
+	_busyUntil = at + 300000;
+	respond("\r\n\xe3\x8c\x82\xd2\xfc\r\n\r\nready\r\n", _busyUntil);
+	if (_joined)
+	{
+		respond("WIFI CONNECTED\r\nWIFI GOT IP\r\n", _busyUntil + timing.join);
+	}
+}
+
+// a byte of a passthrough session - "+++" on its own ends it
+void VirtualESP8266::passthroughByte(uint8_t c, uint64_t at)
+{
+	bool quiet = (at - _lastByte >= timing.packetGap);
+	_lastByte = at;
+
+	if ((c == '+') && ((_plus > 0) || quiet))
+	{
+		if (++_plus == 3)
+		{
+			_state = COMMAND;
+			_plus = 0;
+		}
+		return;
+	}
+
+	// it wasn't "+++" after all
+	static const uint8_t plus[] = { '+', '+' };
+	data(0, plus, _plus, at);
+	_plus = 0;
+	data(0, &c, 1, at);
+}
+
+// a payload on its way to the server
+void VirtualESP8266::data(uint8_t link, const uint8_t *data, size_t size, uint64_t at)
+{
+	if (size == 0)
+	{
+		return;
+	}
+	_links[link].bytesIn += size;
+	if (_dataHandler)
+	{
+		_dataHandler(link, data, size, at);
+	}
+}
+
+/////////////
+// Helpers //
+/////////////
+
+bool VirtualESP8266::lookup(const std::string &host, IPAddress &ip)
+{
+	unsigned int octet[4];
+	char tail;
+	if (sscanf(host.c_str(), "%u.%u.%u.%u%c", &octet[0], &octet[1], &octet[2], &octet[3], &tail) == 4)
+	{
+		ip = IPAddress(octet[0], octet[1], octet[2], octet[3]);
+		return true;
+	}
+
+	for (size_t i = 0; i < _hosts.size(); i++)
+	{
+		if (_hosts[i].name == host)
+		{
+			ip = _hosts[i].ip;
+			return true;
+		}
+	}
+	return false;
+}
+
+// queue [text] to go out at [at] - the queue is kept in time order (and 
+// things due at the same time go in the order they were said)
+void VirtualESP8266::schedule(uint64_t at, const std::string &text)
+{
+	Output out = { at, text };
+	std::vector<Output>::iterator it = _pending.end();
+	while ((it != _pending.begin()) && ((it - 1)->at > at))
+	{
+		--it;
+	}
+	_pending.insert(it, out);
+}
+
+// [base] plus up to timing.jitter - the same every run
+uint32_t VirtualESP8266::network(uint32_t base)
+{
+	if (timing.jitter == 0)
+	{
+		return base;
+	}
+	_random = _random * 1103515245 + 12345;
+	return base + (_random >> 8) % (timing.jitter + 1);
+}
+
+// [at] of 0 is now
+uint64_t VirtualESP8266::now(uint64_t at)
+{
+	return (at == 0) ? hostClock() : at;
+}
+
+// the link ID at the start of [args] (there isn't one without AT+CIPMUX=1)
+int VirtualESP8266::linkArg(const std::vector<std::string> &args, size_t &next)
+{
+	if (!_mux)
+	{
+		next = 0;
+		return 0;
+	}
+	if (args.empty() || (args[0].size() != 1) || (args[0][0] < '0') ||
+		(args[0][0] >= '0' + VIRTUAL_ESP8266_LINKS))
+	{
+		return -1;
+	}
+	next = 1;
+	return args[0][0] - '0';
+}
@@ -0,0 +1,208 @@
+/**
+VirtualESP8266.h
+
+A simulated ESP8266 running the AT firmware, for building and exercising the
+library on a desktop machine (see extras/host/README.md).
+
+It sits on the other end of the host build's serial line (Serial or
+SoftwareSerial - whichever begin() picked) and answers the commands in
+src/util/ESP8266_AT.h the way AT firmware v1.x does (the v2.0 names without
+_DEF/_CUR are taken too). Everything happens on the simulated clock: bytes
+take as long to cross the uart as they would at the chosen baud rate, and
+connecting, acks, pings and dns lookups take the times in [timing].
+
+The network side is scripted by the test or benchmark:
+
+	VirtualESP8266 esp;
+	esp.addHost("example.com", IPAddress(93, 184, 216, 34));
+	esp.onData([](uint8_t link, const uint8_t *data, size_t size, uint64_t at) { ... });
+	int link = esp.acceptConnection(IPAddress(10, 0, 0, 9), 50000);
+	esp.deliver(link, "hello", 5);
+
+and any command can be answered differently with onCommand().
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#ifndef _VIRTUALESP8266_H_
+#define _VIRTUALESP8266_H_
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#define VIRTUAL_ESP8266_LINKS		5
+#define VIRTUAL_ESP8266_SEGMENT		1460
+#define VIRTUAL_ESP8266_WINDOW		2920
+
+class VirtualESP8266 : public HostUartPeer
+{
+public:
+	VirtualESP8266();
+	~VirtualESP8266();
+
+	// how long things take (in microseconds)
+	struct Timing
+	{
+		uint32_t command;	// end of a command to the start of its response
+		uint32_t connect;	// tcp handshake
+		uint32_t sendAck;	// end of a payload to its SEND OK
+		uint32_t ping;		// round trip reported by AT+PING
+		uint32_t dns;		// AT+CIPDOMAIN (and the lookup in AT+CIPSTART)
+		uint32_t join;		// joining an access point
+		uint32_t packetGap;	// quiet time that ends a passthrough packet
+		uint32_t jitter;	// up to this much longer for connect, sendAck and dns
+	} timing;
+
+	// a link as the module sees it
+	struct Link
+	{
+		bool open;
+		bool udp;
+		bool server;
+		IPAddress remoteIP;
+		uint16_t remotePort;
+		uint16_t localPort;
+		uint64_t opened;
+		uint32_t bytesIn;		// payload from the host
+		uint32_t bytesOut;		// payload delivered to the host
+		uint32_t sends;			// AT+CIPSEND / AT+CIPSENDBUF commands
+	};
+
+	// a command the module has been sent
+	struct Command
+	{
+		uint64_t at;
+		std::string text;
+	};
+
+	// scripting - a handler for commands starting with [prefix] (e.g.
+	// "AT+CIPSTART") is tried before the built in one, and returns false to
+	// fall back to it
+	typedef std::function<bool(VirtualESP8266 &esp, const std::string &command, uint64_t at)> CommandHandler;
+	typedef std::function<void(uint8_t link, const uint8_t *data, size_t size, uint64_t at)> DataHandler;
+	void onCommand(const char *prefix, CommandHandler handler);
+	void onData(DataHandler handler);
+	void addHost(const char *name, IPAddress ip);
+	void refuse(IPAddress ip, uint16_t port);
+	void setJoined(bool joined);
+
+	// the network side - [at] of 0 means now
+	int acceptConnection(IPAddress ip, uint16_t port, uint64_t at = 0);
+	void deliver(uint8_t link, const void *data, size_t size, uint64_t at = 0);
+	void deliverFrom(uint8_t link, IPAddress ip, uint16_t port, const void *data, size_t size, uint64_t at = 0);
+	void closeLink(uint8_t link, uint64_t at = 0);
+	uint64_t respond(const char *text, uint64_t at = 0);
+
+	// what has happened
+	const Link & link(uint8_t linkID) const;
+	const std::vector<Command> & commands() const;
+	uint32_t busyReplies() const;
+	uint64_t idle() const;
+	void clearLog();
+	HostUart & uart();
+
+	void uartByte(HostUart &uart, uint8_t c, uint64_t at);
+	void uartPoll(HostUart &uart, uint64_t now);
+
+private:
+	enum State
+	{
+		COMMAND,
+		PAYLOAD,
+		PASSTHROUGH
+	};
+
+	struct Handler
+	{
+		std::string prefix;
+		CommandHandler handler;
+	};
+
+	struct Host
+	{
+		std::string name;
+		IPAddress ip;
+	};
+
+	struct Output
+	{
+		uint64_t at;
+		std::string text;
+	};
+
+	struct Segment
+	{
+		uint16_t id;
+		uint16_t length;
+		uint64_t acked;
+	};
+
+	void command(const std::string &text, uint64_t at);
+	bool builtIn(const std::string &name, char kind, const std::vector<std::string> &args, uint64_t at);
+	void payloadDone(uint64_t at);
+	void passthroughByte(uint8_t c, uint64_t at);
+	void data(uint8_t link, const uint8_t *data, size_t size, uint64_t at);
+
+	void start(const std::vector<std::string> &args, uint64_t at);
+	void send(const std::vector<std::string> &args, bool buffered, uint64_t at);
+	void bufferStatus(uint8_t link, uint64_t at);
+	void close(int link, uint64_t at);
+	void status(uint64_t at);
+	void reset(uint64_t at);
+
+	void schedule(uint64_t at, const std::string &text);
+	bool lookup(const std::string &host, IPAddress &ip);
+	uint32_t network(uint32_t base);
+	uint64_t now(uint64_t at);
+	int linkArg(const std::vector<std::string> &args, size_t &next);
+
+	HostUart *_uart;
+	State _state;
+
+	// what we are going to say, in time order
+	std::vector<Output> _pending;
+
+	std::string _line;
+	uint64_t _busyUntil;
+
+	bool _echo;
+	bool _mux;
+	bool _passthroughMode;
+	bool _dataInfo;
+	bool _joined;
+	uint16_t _serverPort;
+	uint8_t _status;
+
+	Link _links[VIRTUAL_ESP8266_LINKS];
+
+	// the payload of the AT+CIPSEND being received
+	uint8_t _payloadLink;
+	uint16_t _payloadLeft;
+	uint16_t _payloadLen;
+	bool _payloadBuffered;
+	std::string _payload;
+
+	// AT+CIPSENDBUF segments not acked yet (on every link)
+	uint16_t _nextSegment[VIRTUAL_ESP8266_LINKS];
+	uint16_t _ackedSegment[VIRTUAL_ESP8266_LINKS];
+	std::vector<Segment> _segments[VIRTUAL_ESP8266_LINKS];
+
+	// passthrough "+++" detection
+	uint64_t _lastByte;
+	uint8_t _plus;
+
+	std::vector<Handler> _handlers;
+	std::vector<Host> _hosts;
+	std::vector<std::pair<uint32_t, uint16_t> > _refused;
+	DataHandler _dataHandler;
+	std::vector<Command> _commands;
+	uint32_t _busyReplies;
+	uint32_t _random;
+};
+
+#endif
@@ -0,0 +1,98 @@
+/**
+ATESP8266ClientReadBufferTest.cpp
+
+Tests for the +IPD frame parser and the per-link receive buffers (see
+src/ATESP8266ClientReadBuffer.h).
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "ATESP8266Test.h"
+
+// +IPD payloads are taken by length, so text in them that looks like a
+// response or a link event isn't mistaken for one - even with a command
+// waiting on its response at the time (the payload fits in the link's ring,
+// as nothing reads it until the ping is done)
+ESP8266_TEST(ipd_framing)
+{
+	ESP8266Client client;
+	CHECK(client.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+	int link = firstOpenLink(esp);
+	CHECK(link >= 0);
+
+	std::string payload = "\r\nERROR\r\n+IPD,0,3:abc\r\n0,CLOSED\r\nbusy p...\r\nOK\r\n";
+	payload += std::string(ESP8266_CLIENT_MAX_BUFFER_SIZE - payload.size(), 'z');
+	esp.deliver(link, payload.data(), payload.size(), hostClock() + 2000);
+	CHECK(esp8266.ping(IPAddress(10, 0, 0, 1)) > 0);
+
+	CHECK(readAll(client, payload.size()) == payload);
+	CHECK(client.connected());
+	CHECK(esp8266._state[link] != 0);
+}
+
+// a link whose buffer is full only loses its own data (and says so) - the
+// other links (and the link events) keep coming
+ESP8266_TEST(full_link_isolated)
+{
+	ESP8266Client full;
+	ESP8266Client other;
+	CHECK(full.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+	CHECK(other.connect(IPAddress(10, 0, 0, 2), 80) > 0);
+
+	std::string flood;
+	for (int i = 0; i < 400; i++)
+	{
+		flood += (char)('a' + (i % 26));
+	}
+	esp.deliver(0, flood.data(), flood.size());
+	esp.deliver(1, "ping", 4);
+
+	uint64_t start = hostClock();
+	CHECK(readAll(other, 4) == "ping");
+	CHECK(hostClock() - start < 100000);
+
+	esp.closeLink(1);
+	settle(10000);
+	CHECK(!other.connected());
+
+	// the full link kept what it had room for
+	CHECK(readAll(full, flood.size()) == flood.substr(0, ESP8266_CLIENT_MAX_BUFFER_SIZE));
+	CHECK(full.connected());
+	CHECK(full.overflowed());
+	CHECK(!other.overflowed());
+
+	// until the link is used for a new connection
+	full.stop();
+	CHECK(full.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+	CHECK(!full.overflowed());
+}
+
+// a bulk read from a ring whose head is partway round gets the data that
+// wraps past the end of the ring too, in order
+ESP8266_TEST(read_wrapped)
+{
+	ESP8266Client client;
+	CHECK(client.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+	int link = firstOpenLink(esp);
+	CHECK(link >= 0);
+
+	size_t offset = ESP8266_CLIENT_MAX_BUFFER_SIZE / 2 + 3;
+	std::string first(offset, '-');
+	esp.deliver(link, first.data(), first.size());
+	CHECK(readAll(client, first.size()) == first);
+
+	std::string second;
+	for (size_t i = 0; i < ESP8266_CLIENT_MAX_BUFFER_SIZE - 10; i++)
+	{
+		second += (char)('a' + (i % 26));
+	}
+	esp.deliver(link, second.data(), second.size());
+	settle(100000);
+
+	uint8_t buf[ESP8266_CLIENT_MAX_BUFFER_SIZE];
+	int n = client.read(buf, sizeof(buf));
+	CHECK(n == (int)second.size());
+	CHECK((n > 0) && (std::string((const char *)buf, n) == second));
+	CHECK(client.available() == 0);
+}
@@ -0,0 +1,122 @@
+/**
+ATESP8266ClientTest.cpp
+
+Regression tests for ESP8266Client, and the pool of links it keeps open
+between connects (see ATESP8266Test.h).
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "ATESP8266Test.h"
+
+// a connect() to where a pooled link already goes uses it, without another
+// AT+CIPSTART
+ESP8266_TEST(pool_reuse)
+{
+	esp8266.setPoolSize(2);
+
+	ESP8266Client client;
+	CHECK(client.connect("10.0.0.5", 80) > 0);
+	int link = firstOpenLink(esp);
+	CHECK(link >= 0);
+	client.stop();
+	settle(100000);
+	CHECK((link >= 0) && esp.link(link).open);
+
+	CHECK(client.connect("10.0.0.5", 80) > 0);
+	CHECK(countCommands(esp, "AT+CIPSTART") == 1);
+	client.print("again");
+	client.flush();
+	settle(100000);
+	CHECK((link >= 0) && (esp.link(link).bytesIn == 5));
+
+	// somewhere else needs a new link
+	ESP8266Client other;
+	CHECK(other.connect("10.0.0.5", 8080) > 0);
+	CHECK(countCommands(esp, "AT+CIPSTART") == 2);
+}
+
+// a connect() that can't even be sent doesn't keep hold of its link
+ESP8266_TEST(connect_unsent)
+{
+	std::string host(ESP8266_TX_BUFFER_LEN, 'h');
+	ESP8266Client client;
+	for (uint8_t i = 0; i <= ESP8266_MAX_SOCK_NUM; i++)
+	{
+		CHECK(client.connect(host.c_str(), 80) < 0);
+	}
+	CHECK(countCommands(esp, "AT+CIPSTART") == 0);
+
+	CHECK(client.connect("10.0.0.5", 80) > 0);
+	CHECK(countCommands(esp, "AT+CIPSTART") == 1);
+}
+
+// pooled links the server closes, or that sit idle too long, aren't handed
+// out again
+ESP8266_TEST(pool_expiry)
+{
+	esp8266.setPoolSize(2);
+	esp8266.setPoolTimeout(1000);
+
+	ESP8266Client client;
+	CHECK(client.connect("10.0.0.5", 80) > 0);
+	int link = firstOpenLink(esp);
+	client.stop();
+	esp.closeLink(link);
+	settle(100000);
+	CHECK(client.connect("10.0.0.5", 80) > 0);
+	CHECK(countCommands(esp, "AT+CIPSTART") == 2);
+
+	client.stop();
+	settle(1500000);
+	CHECK(client.connect("10.0.0.5", 80) > 0);
+	CHECK(countCommands(esp, "AT+CIPSTART") == 3);
+}
+
+// with the pool full, the link idle the longest is the one closed
+ESP8266_TEST(pool_eviction)
+{
+	esp8266.setPoolSize(1);
+
+	ESP8266Client first;
+	ESP8266Client second;
+	CHECK(first.connect("10.0.0.5", 80) > 0);
+	CHECK(second.connect("10.0.0.6", 80) > 0);
+	int firstLink = -1;
+	int secondLink = -1;
+	for (uint8_t i = 0; i < VIRTUAL_ESP8266_LINKS; i++)
+	{
+		if (esp.link(i).open && (esp.link(i).remoteIP == IPAddress(10, 0, 0, 5)))
+		{
+			firstLink = i;
+		}
+		if (esp.link(i).open && (esp.link(i).remoteIP == IPAddress(10, 0, 0, 6)))
+		{
+			secondLink = i;
+		}
+	}
+	CHECK((firstLink >= 0) && (secondLink >= 0));
+
+	first.stop();
+	settle(10000);
+	second.stop();
+	settle(100000);
+	CHECK((firstLink >= 0) && !esp.link(firstLink).open);
+	CHECK((secondLink >= 0) && esp.link(secondLink).open);
+
+	// and without a pool stop() closes the link
+	esp8266.setPoolSize(0);
+	CHECK(first.connect("10.0.0.7", 80) > 0);
+	int link = -1;
+	for (uint8_t i = 0; i < VIRTUAL_ESP8266_LINKS; i++)
+	{
+		if (esp.link(i).open && (esp.link(i).remoteIP == IPAddress(10, 0, 0, 7)))
+		{
+			link = i;
+		}
+	}
+	first.stop();
+	settle(100000);
+	CHECK((link >= 0) && !esp.link(link).open);
+}
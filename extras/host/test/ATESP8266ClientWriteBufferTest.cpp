@@ -0,0 +1,87 @@
+/**
+ATESP8266ClientWriteBufferTest.cpp
+
+Tests for the per-link transmit buffers (see
+src/ATESP8266ClientWriteBuffer.h).
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "ATESP8266Test.h"
+
+// small buffered writes go out together, in order
+ESP8266_TEST(buffered_send)
+{
+	std::string received;
+	esp.onData([&](uint8_t link, const uint8_t *data, size_t size, uint64_t at) {
+		(void)link;
+		(void)at;
+		received.append((const char *)data, size);
+	});
+
+	ESP8266Client client;
+	CHECK(client.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+	int link = firstOpenLink(esp);
+	client.setBufferedSend(true);
+
+	std::string sent;
+	for (int i = 0; i < 10; i++)
+	{
+		std::string piece = "piece " + std::to_string(i) + "\r\n";
+		CHECK(client.write((const uint8_t *)piece.data(), piece.size()) == piece.size());
+		sent += piece;
+	}
+	client.flush();
+	CHECK(waitFor([&] { return received.size() >= sent.size(); }));
+	CHECK(received == sent);
+	CHECK((link >= 0) && (esp.link(link).sends < 10));
+	esp.onData(NULL);
+}
+
+// a background send that fails is reported by the next write, and the link
+// takes nothing more until then
+ESP8266_TEST(buffered_send_failure)
+{
+	ESP8266Client client;
+	CHECK(client.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+	esp.onCommand("AT+CIPSEND", [](VirtualESP8266 &e, const std::string &command, uint64_t at) {
+		(void)command;
+		e.respond("\r\nERROR\r\n", at);
+		return true;
+	});
+
+	CHECK(client.write((const uint8_t *)"hello", 5) == 5);
+	settle(200000);
+	CHECK(client.availableForWrite() == 0);
+	CHECK(client.write((const uint8_t *)"hello", 5) == 0);
+	CHECK(client.availableForWrite() > 0);
+}
+
+// a blocking call made while client data is waiting to go gets its own
+// response, without waiting for the data - which still goes afterwards
+ESP8266_TEST(blocking_call_with_background_send)
+{
+	ESP8266Client client;
+	CHECK(client.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+
+	client.print("hello");
+	hostAdvance(50000);
+	CHECK(esp8266.localIP() == IPAddress(10, 0, 0, 2));
+	settle(100000);
+	CHECK(esp.link(0).bytesIn == 5);
+
+	esp.onCommand("AT+PING", [](VirtualESP8266 &e, const std::string &command, uint64_t at) {
+		(void)e;
+		(void)command;
+		(void)at;
+		return true;
+	});
+	client.print("again");
+	hostAdvance(50000);
+	CHECK(esp8266.ping(IPAddress(10, 0, 0, 1)) == ESP8266_RSP_TIMEOUT);
+	CHECK(esp.link(0).bytesIn == 5);
+
+	settle(200000);
+	CHECK(esp.link(0).bytesIn == 10);
+}
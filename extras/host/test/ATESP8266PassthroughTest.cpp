@@ -0,0 +1,56 @@
+/**
+ATESP8266PassthroughTest.cpp
+
+Tests for passthrough sessions (see src/ATESP8266Passthrough.h).
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "ATESP8266Test.h"
+#include <ATESP8266Passthrough.h>
+
+// in a session what we write goes straight to the server and what it sends
+// comes straight back (with nothing parsed out of it), and afterwards the
+// module takes AT commands again
+ESP8266_TEST(passthrough_session)
+{
+	std::string received;
+	esp.onData([&](uint8_t link, const uint8_t *data, size_t size, uint64_t at) {
+		(void)link;
+		(void)at;
+		received.append((const char *)data, size);
+	});
+
+	ESP8266Passthrough stream;
+	CHECK(stream.begin(IPAddress(10, 0, 0, 1), 80) == ESP8266_RSP_SUCCESS);
+	CHECK(stream.active());
+	int link = firstOpenLink(esp);
+	CHECK(link >= 0);
+
+	std::string request = "GET / HTTP/1.0\r\n\r\nAT+CIPSEND=0,5\r\n";
+	CHECK(stream.write((const uint8_t *)request.data(), request.size()) == request.size());
+
+	// (poll() leaves the uart alone during a session, so it doesn't move the
+	// clock)
+	hostAdvance(100000);
+	CHECK(received == request);
+
+	std::string reply = "HTTP/1.0 200 OK\r\n\r\n+IPD,0,4:\r\n0,CLOSED\r\nOK\r\n";
+	esp.deliver(link, reply.data(), reply.size());
+	std::string got;
+	waitFor([&] {
+		while (stream.available() > 0)
+		{
+			got += (char)stream.read();
+		}
+		return got.size() >= reply.size();
+	});
+	CHECK(got == reply);
+
+	CHECK(stream.end() == ESP8266_RSP_SUCCESS);
+	CHECK(!stream.active());
+	CHECK(!esp.link(link).open);
+	CHECK(esp8266.localIP() == IPAddress(10, 0, 0, 2));
+	esp.onData(NULL);
+}
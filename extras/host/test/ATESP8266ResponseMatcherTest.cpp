@@ -0,0 +1,50 @@
+/**
+ATESP8266ResponseMatcherTest.cpp
+
+Tests for the response matcher (see src/ATESP8266ResponseMatcher.h).
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "ATESP8266Test.h"
+
+// the response matcher finds each pattern, including ones that start inside
+// a partial match of themselves
+ESP8266_TEST(matcher)
+{
+	ESP8266ResponseMatcher matcher;
+	CHECK(matcher.add("OK\r\n") == 0);
+	CHECK(matcher.add("ERROR\r\n") == 1);
+	CHECK(matcher.add("aab") == 2);
+	CHECK(!matcher.dropped());
+	CHECK(matcher.add("0123456789abcdefg") == ESP8266_MATCHER_NO_MATCH);
+	CHECK(matcher.dropped());
+
+	const char *input = "xOERRORK\r\nERROR\r\naaab";
+	int8_t found[32];
+	uint8_t count = 0;
+	for (const char *p = input; *p != '\0'; p++)
+	{
+		int8_t match = matcher.feed(*p);
+		if (match != ESP8266_MATCHER_NO_MATCH)
+		{
+			found[count++] = match;
+		}
+	}
+	CHECK(count == 2);
+	CHECK((count > 0) && (found[0] == 1));
+	CHECK((count > 1) && (found[1] == 2));
+
+	// restart() forgets the partial match
+	matcher.feed('O');
+	matcher.restart();
+	CHECK(matcher.feed('K') == ESP8266_MATCHER_NO_MATCH);
+	CHECK(matcher.feed('\r') == ESP8266_MATCHER_NO_MATCH);
+
+	CHECK(matcher.add("x") == 3);
+	CHECK(matcher.add("y") == ESP8266_MATCHER_NO_MATCH);
+	matcher.reset();
+	CHECK(!matcher.dropped());
+	CHECK(matcher.feed('x') == ESP8266_MATCHER_NO_MATCH);
+}
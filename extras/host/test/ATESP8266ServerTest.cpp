@@ -0,0 +1,143 @@
+/**
+ATESP8266ServerTest.cpp
+
+Tests for ESP8266Server (see src/ATESP8266Server.h).
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "ATESP8266Test.h"
+
+// a server write that one link refuses still goes to the others, only counts
+// what was sent, and drops the dead link
+ESP8266_TEST(server_write_failure)
+{
+	ESP8266Server server(80);
+	server.begin();
+	int a = esp.acceptConnection(IPAddress(10, 0, 0, 9), 50000);
+	int b = esp.acceptConnection(IPAddress(10, 0, 0, 10), 50001);
+	CHECK((a == 0) && (b == 1));
+	settle(100000);
+
+	esp.onCommand("AT+CIPSEND=1", [](VirtualESP8266 &e, const std::string &command, uint64_t at) {
+		(void)command;
+		e.respond("\r\nERROR\r\n", at);
+		return true;
+	});
+	CHECK(server.write((const uint8_t *)"status", 6) == 6);
+	CHECK(server.write((const uint8_t *)"status", 6) == 6);
+	settle(100000);
+
+	CHECK(esp.link(0).bytesIn == 12);
+	CHECK(esp.link(1).bytesIn == 0);
+	CHECK(esp8266._state[1] == 0);
+}
+
+// what a server write returns is what went to the clients, counted once
+// however many there are - and nothing if none of them took it
+ESP8266_TEST(server_write_count)
+{
+	ESP8266Server server(80);
+	server.begin();
+	CHECK(esp.acceptConnection(IPAddress(10, 0, 0, 9), 50000) == 0);
+	CHECK(esp.acceptConnection(IPAddress(10, 0, 0, 10), 50001) == 1);
+	settle(100000);
+
+	CHECK(server.write((const uint8_t *)"status", 6) == 6);
+	CHECK(server.println("ok") == 4);
+	settle(100000);
+	CHECK(esp.link(0).bytesIn == 10);
+	CHECK(esp.link(1).bytesIn == 10);
+
+	esp.onCommand("AT+CIPSEND", [](VirtualESP8266 &e, const std::string &command, uint64_t at) {
+		(void)command;
+		e.respond("\r\nERROR\r\n", at);
+		return true;
+	});
+	CHECK(server.write((const uint8_t *)"status", 6) == 0);
+}
+
+// connections that arrive while nobody is accepting are handed out in the
+// order they connected
+ESP8266_TEST(accept_order)
+{
+	ESP8266Server server(80);
+	server.begin();
+	const char *names[] = { "first", "second", "third" };
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		int link = esp.acceptConnection(IPAddress(10, 0, 0, 9 + i), 50000 + i);
+		esp.deliver(link, names[i], strlen(names[i]));
+		settle(10000);
+	}
+	settle(100000);
+
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		ESP8266Client client = server.accept();
+		CHECK(client);
+		CHECK(readAll(client, strlen(names[i])) == names[i]);
+	}
+	CHECK(!server.accept());
+}
+
+// a connection that closes before it is accepted is never handed out
+ESP8266_TEST(accept_skips_closed)
+{
+	ESP8266Server server(80);
+	server.begin();
+	int a = esp.acceptConnection(IPAddress(10, 0, 0, 9), 50000);
+	int b = esp.acceptConnection(IPAddress(10, 0, 0, 10), 50001);
+	int c = esp.acceptConnection(IPAddress(10, 0, 0, 11), 50002);
+	esp.deliver(a, "a", 1);
+	esp.deliver(c, "c", 1);
+	settle(100000);
+	esp.closeLink(b);
+	settle(100000);
+
+	ESP8266Client first = server.accept();
+	ESP8266Client second = server.accept();
+	CHECK(first && second);
+	CHECK(readAll(first, 1) == "a");
+	CHECK(readAll(second, 1) == "c");
+	CHECK(!server.accept());
+}
+
+// available() takes turns between the clients with something to read, so a
+// busy one can't keep the others waiting
+ESP8266_TEST(available_round_robin)
+{
+	ESP8266Server server(80);
+	server.begin();
+	int a = esp.acceptConnection(IPAddress(10, 0, 0, 9), 50000);
+	int b = esp.acceptConnection(IPAddress(10, 0, 0, 10), 50001);
+	int c = esp.acceptConnection(IPAddress(10, 0, 0, 11), 50002);
+	settle(100000);
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		CHECK(server.accept());
+	}
+
+	// a always has more to read, and b and c each have a little
+	std::string flood(32, 'a');
+	esp.deliver(a, flood.data(), flood.size());
+	esp.deliver(b, "bb", 2);
+	esp.deliver(c, "cc", 2);
+	settle(100000);
+
+	std::string order;
+	for (uint8_t i = 0; i < 6; i++)
+	{
+		ESP8266Client client = server.available();
+		CHECK(client);
+		order += (char)client.read();
+	}
+	CHECK(order == "abcabc");
+
+	// and once the others have run out a is the only one
+	ESP8266Client client = server.available();
+	CHECK(client && (client.read() == 'a'));
+	client = server.available();
+	CHECK(client && (client.read() == 'a'));
+}
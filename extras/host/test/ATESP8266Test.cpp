@@ -0,0 +1,116 @@
+/**
+ATESP8266Test.cpp
+
+Regression tests for the library, run against the simulated module (see
+extras/host/README.md). Each test is a separate run, so every one gets a
+fresh esp8266:
+
+	atesp8266_test <test>
+
+and with no test named it lists them. ctest runs them all. The tests
+themselves are in the file for the part of the library they cover (see
+ATESP8266Test.h).
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "ATESP8266Test.h"
+
+#include <map>
+
+static int failures = 0;
+
+// every test, by name (filled in before main() by ESP8266_TEST)
+static std::map<std::string, TestFunction> & tests()
+{
+	static std::map<std::string, TestFunction> registered;
+	return registered;
+}
+
+TestRegistration::TestRegistration(const char *name, TestFunction run)
+{
+	tests()[name] = run;
+}
+
+void testCheck(bool ok, const char *what, const char *file, int line)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, what);
+		failures++;
+	}
+}
+
+void settle(uint64_t us)
+{
+	uint64_t start = hostClock();
+	waitFor([&] { return hostClock() - start >= us; });
+}
+
+std::string readAll(ESP8266Client &client, size_t size)
+{
+	std::string data;
+	waitFor([&] {
+		uint8_t buf[64];
+		int n = client.read(buf, sizeof(buf));
+		if (n > 0)
+		{
+			data.append((const char *)buf, n);
+		}
+		return data.size() >= size;
+	});
+	return data;
+}
+
+int firstOpenLink(VirtualESP8266 &esp)
+{
+	for (uint8_t i = 0; i < VIRTUAL_ESP8266_LINKS; i++)
+	{
+		if (esp.link(i).open)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+int countCommands(VirtualESP8266 &esp, const char *prefix)
+{
+	int count = 0;
+	for (size_t i = 0; i < esp.commands().size(); i++)
+	{
+		if (esp.commands()[i].text.compare(0, strlen(prefix), prefix) == 0)
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc == 2)
+	{
+		std::map<std::string, TestFunction>::iterator test = tests().find(argv[1]);
+		if (test != tests().end())
+		{
+			VirtualESP8266 esp;
+			if (!esp8266.begin(115200, ESP8266_HARDWARE_SERIAL))
+			{
+				fprintf(stderr, "begin() failed\n");
+				return 1;
+			}
+			test->second(esp);
+			return (failures == 0) ? 0 : 1;
+		}
+	}
+
+	fprintf(stderr, "usage: %s <test>\n\ntests:\n", argv[0]);
+	std::map<std::string, TestFunction>::iterator test;
+	for (test = tests().begin(); test != tests().end(); ++test)
+	{
+		fprintf(stderr, "  %s\n", test->first.c_str());
+	}
+	return 1;
+}
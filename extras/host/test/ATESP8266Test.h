@@ -0,0 +1,87 @@
+/**
+ATESP8266Test.h
+
+What the regression tests share. A test goes in the file for the part of
+the library it covers (ATESP8266<part>Test.cpp) as
+
+	ESP8266_TEST(name)
+	{
+		CHECK(...);
+	}
+
+where [esp] is the simulated module on the other end of the uart, and its
+name goes in the list in CMakeLists.txt so ctest runs it.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#ifndef _ATESP8266TEST_H_
+#define _ATESP8266TEST_H_
+
+#include <ATESP8266WiFi.h>
+#include <VirtualESP8266.h>
+
+#include <string>
+
+// give up on anything that takes longer than this (simulated) time
+#define TEST_TIMEOUT 10000000ULL
+
+typedef void (*TestFunction)(VirtualESP8266 &esp);
+
+struct TestRegistration
+{
+	TestRegistration(const char *name, TestFunction run);
+};
+
+#define ESP8266_TEST(name) \
+	static void test_##name(VirtualESP8266 &esp); \
+	static TestRegistration register_##name(#name, test_##name); \
+	static void test_##name(VirtualESP8266 &esp)
+
+#define CHECK(x) testCheck((x), #x, __FILE__, __LINE__)
+
+void testCheck(bool ok, const char *what, const char *file, int line);
+
+// poll until [done] (or the timeout)
+template <typename F>
+bool waitFor(F done)
+{
+	uint64_t start = hostClock();
+	while (!done())
+	{
+		if (hostClock() - start > TEST_TIMEOUT)
+		{
+			return false;
+		}
+		esp8266.poll();
+	}
+	return true;
+}
+
+// a Print that collects what is written to it
+class StringPrint : public Print
+{
+public:
+	size_t write(uint8_t c)
+	{
+		text += (char)c;
+		return 1;
+	}
+
+	std::string text;
+};
+
+// let (simulated) time pass with esp8266 running
+void settle(uint64_t us);
+
+// read until [size] bytes have come (or the timeout)
+std::string readAll(ESP8266Client &client, size_t size);
+
+// the lowest link the module has open (-1 if there isn't one)
+int firstOpenLink(VirtualESP8266 &esp);
+
+// how many commands starting with [prefix] the module has been sent
+int countCommands(VirtualESP8266 &esp, const char *prefix);
+
+#endif
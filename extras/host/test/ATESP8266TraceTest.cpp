@@ -0,0 +1,93 @@
+/**
+ATESP8266TraceTest.cpp
+
+Regression tests for the uart trace and ESP8266TraceReplay (see 
+ATESP8266Test.h). These are only built into atesp8266_trace_test, against
+the library with ESP8266_TRACE defined.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "ATESP8266Test.h"
+
+#ifdef ESP8266_TRACE
+
+#include <vector>
+
+// the bytes going one way, in the order they went
+static std::string traced(const std::vector<esp8266_trace_record> &records, uint8_t type)
+{
+	std::string bytes;
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		if (records[i].type == type)
+		{
+			bytes += (char)records[i].c;
+		}
+	}
+	return bytes;
+}
+
+// everything sent and read is recorded (in order), and dump() writes it out
+// with the header in front
+ESP8266_TEST(trace_record)
+{
+	esp8266.trace().clear();
+	CHECK(esp8266.ping(IPAddress(10, 0, 0, 1)) > 0);
+
+	std::vector<esp8266_trace_record> records(esp8266.trace().available());
+	CHECK(esp8266.trace().read(records.data(), records.size()) == records.size());
+	CHECK(traced(records, ESP8266_TRACE_TX) == "AT+PING=\"10.0.0.1\"\r\n");
+	CHECK(traced(records, ESP8266_TRACE_RX).find("OK\r\n") != std::string::npos);
+	CHECK(esp8266.trace().lost() == 0);
+
+	StringPrint out;
+	CHECK(esp8266.trace().dump(out) == 8 + 4 * records.size());
+	CHECK(out.text.compare(0, 4, "ESPT") == 0);
+	CHECK((uint8_t)out.text[4] == ESP8266_TRACE_VERSION);
+	CHECK((size_t)((uint8_t)out.text[6] | ((uint8_t)out.text[7] << 8)) == records.size());
+
+	// nothing more is kept while it is turned off
+	esp8266.trace().enable(false);
+	CHECK(esp8266.ping(IPAddress(10, 0, 0, 1)) > 0);
+	CHECK(esp8266.trace().available() == records.size());
+	esp8266.trace().enable(true);
+}
+
+// a recorded session played back goes through the parser the same way -
+// every command gets its response, and all the +IPD data is seen
+ESP8266_TEST(trace_replay)
+{
+	ESP8266Client client;
+	CHECK(client.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+	int link = firstOpenLink(esp);
+	esp8266.trace().clear();
+	esp.clearLog();
+
+	client.print("hello");
+	client.flush();
+	std::string reply(300, 'x');
+	esp.deliver(link, reply.data(), reply.size());
+	CHECK(readAll(client, reply.size()) == reply);
+	CHECK(esp8266.ping(IPAddress(10, 0, 0, 1)) > 0);
+	client.stop();
+	settle(100000);
+	int commands = (int)esp.commands().size();
+
+	std::vector<esp8266_trace_record> records(esp8266.trace().available());
+	esp8266.trace().read(records.data(), records.size());
+	size_t rx = traced(records, ESP8266_TRACE_RX).size();
+
+	ESP8266TraceReplay replay;
+	replay.begin(records.data(), records.size(), 0);
+	replay.run();
+	CHECK(replay.commands() == commands);
+	CHECK(replay.passed() == commands);
+	CHECK(replay.failed() == 0);
+	CHECK(replay.timedOut() == 0);
+	CHECK(replay.received() == rx);
+	CHECK(replay.payload() == reply.size());
+}
+
+#endif
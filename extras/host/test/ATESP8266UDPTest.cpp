@@ -0,0 +1,167 @@
+/**
+ATESP8266UDPTest.cpp
+
+Regression tests for ESP8266UDP (see ATESP8266Test.h).
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "ATESP8266Test.h"
+#include <ATESP8266UDP.h>
+
+#include <string>
+
+// read the rest of the current datagram
+static std::string readPacket(ESP8266UDP &udp)
+{
+	std::string data;
+	int c;
+	while ((c = udp.read()) >= 0)
+	{
+		data += (char)c;
+	}
+	return data;
+}
+
+// each datagram comes out on its own, with who sent it
+ESP8266_TEST(udp_receive)
+{
+	ESP8266UDP udp;
+	CHECK(udp.begin(5000) == 1);
+	int link = firstOpenLink(esp);
+	CHECK((link >= 0) && esp.link(link).udp);
+
+	esp.deliverFrom(link, IPAddress(10, 0, 0, 7), 6000, "hello", 5);
+	esp.deliverFrom(link, IPAddress(10, 0, 0, 8), 6001, "udp", 3);
+	settle(100000);
+
+	CHECK(udp.parsePacket() == 5);
+	CHECK(udp.remoteIP() == IPAddress(10, 0, 0, 7));
+	CHECK(udp.remotePort() == 6000);
+	CHECK(readPacket(udp) == "hello");
+
+	CHECK(udp.parsePacket() == 3);
+	CHECK(udp.remoteIP() == IPAddress(10, 0, 0, 8));
+	CHECK(udp.remotePort() == 6001);
+	CHECK(readPacket(udp) == "udp");
+
+	CHECK(udp.parsePacket() == 0);
+}
+
+// everything written between beginPacket() and endPacket() goes out as one
+// datagram
+ESP8266_TEST(udp_send)
+{
+	std::string sent;
+	int sends = 0;
+	esp.onData([&](uint8_t, const uint8_t *data, size_t size, uint64_t) {
+		sent.append((const char *)data, size);
+		sends++;
+	});
+
+	ESP8266UDP udp;
+	CHECK(udp.begin(5000) == 1);
+	CHECK(udp.beginPacket(IPAddress(10, 0, 0, 7), 6000) == 1);
+	udp.print("hello ");
+	udp.print("world");
+	CHECK(udp.endPacket() == 1);
+	settle(100000);
+
+	CHECK(sent == "hello world");
+	CHECK(sends == 1);
+
+	bool addressed = false;
+	for (size_t i = 0; i < esp.commands().size(); i++)
+	{
+		if (esp.commands()[i].text.find(",11,\"10.0.0.7\",6000") != std::string::npos)
+		{
+			addressed = true;
+		}
+	}
+	CHECK(addressed);
+
+	// nothing written, nothing sent
+	CHECK(udp.beginPacket(IPAddress(10, 0, 0, 7), 6000) == 1);
+	CHECK(udp.endPacket() == 0);
+}
+
+// a datagram that doesn't fit in what is left of the buffer is dropped
+// whole, not handed over cut short - and the ones after it still get through
+ESP8266_TEST(udp_truncation)
+{
+	ESP8266UDP udp;
+	CHECK(udp.begin(5000) == 1);
+	int link = firstOpenLink(esp);
+
+	std::string first(200, 'a');
+	std::string second(100, 'b');
+	std::string third(40, 'c');
+	esp.deliverFrom(link, IPAddress(10, 0, 0, 7), 6000, first.data(), first.size());
+	esp.deliverFrom(link, IPAddress(10, 0, 0, 8), 6000, second.data(), second.size());
+	esp.deliverFrom(link, IPAddress(10, 0, 0, 9), 6000, third.data(), third.size());
+	settle(200000);
+
+	CHECK(udp.parsePacket() == 200);
+	CHECK(readPacket(udp) == first);
+	CHECK(udp.parsePacket() == 40);
+	CHECK(udp.remoteIP() == IPAddress(10, 0, 0, 9));
+	CHECK(readPacket(udp) == third);
+	CHECK(udp.parsePacket() == 0);
+}
+
+// a datagram written bigger than the send buffer isn't sent cut short - it
+// isn't sent at all (and the next one is fine)
+ESP8266_TEST(udp_send_overflow)
+{
+	int sends = 0;
+	esp.onData([&](uint8_t, const uint8_t *, size_t, uint64_t) {
+		sends++;
+	});
+
+	ESP8266UDP udp;
+	CHECK(udp.begin(5000) == 1);
+	std::string big(ESP8266_UDP_TX_BUFFER_SIZE + 1, 'x');
+	CHECK(udp.beginPacket(IPAddress(10, 0, 0, 7), 6000) == 1);
+	udp.write((const uint8_t *)big.data(), ESP8266_UDP_TX_BUFFER_SIZE - 1);
+	CHECK(udp.write((const uint8_t *)"yz", 2) == 0);
+	CHECK(udp.endPacket() == 0);
+	settle(100000);
+	CHECK(sends == 0);
+	CHECK(countCommands(esp, "AT+CIPSEND") == 0);
+
+	CHECK(udp.beginPacket(IPAddress(10, 0, 0, 7), 6000) == 1);
+	CHECK(udp.write((const uint8_t *)big.data(), big.size()) == 0);
+	CHECK(udp.endPacket() == 0);
+
+	CHECK(udp.beginPacket(IPAddress(10, 0, 0, 7), 6000) == 1);
+	udp.print("fits");
+	CHECK(udp.endPacket() == 1);
+	settle(100000);
+	CHECK(sends == 1);
+}
+
+// a status update doesn't take a UDP link's local port for its tetype, so
+// the link isn't offered to (or written to by) a server
+ESP8266_TEST(udp_status_local_port)
+{
+	ESP8266Server server(80);
+	server.begin();
+	ESP8266UDP udp;
+	CHECK(udp.begin(1234) == 1);
+	int link = firstOpenLink(esp);
+	CHECK(link >= 0);
+	if (link < 0)
+	{
+		return;
+	}
+
+	CHECK(esp8266.updateStatus() > 0);
+
+	esp.deliverFrom(link, IPAddress(10, 0, 0, 7), 6000, "hello", 5);
+	settle(100000);
+	CHECK(!server.available());
+	CHECK(server.write((const uint8_t *)"status", 6) == 0);
+	CHECK(udp.parsePacket() == 5);
+	CHECK(readPacket(udp) == "hello");
+}
@@ -0,0 +1,566 @@
+/**
+ATESP8266WiFiTest.cpp
+
+Tests for ESP8266Class - the command engine, the response ring, the
+unsolicited result codes and the socket table (see src/ATESP8266WiFi.h).
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "ATESP8266Test.h"
+
+// the response is found wherever it lands in the ring, including across the
+// point where it wraps
+ESP8266_TEST(response_ring)
+{
+	static std::string response;
+	esp.onCommand("AT+CIFSR", [](VirtualESP8266 &e, const std::string &command, uint64_t at) {
+		(void)command;
+		e.respond(response.c_str(), at);
+		return true;
+	});
+
+	for (size_t pad = 0; pad < ESP8266_RX_BUFFER_LEN; pad += 3)
+	{
+		response = std::string(pad, 'x') + "\r\n+CIFSR:STAIP,\"192.168.4.21\"\r\n" +
+				   "+CIFSR:STAMAC,\"18:fe:34:9d:b7:d9\"\r\n\r\nOK\r\n";
+		CHECK(esp8266.localIP() == IPAddress(192, 168, 4, 21));
+	}
+}
+
+// +IPD frames that arrive once a response has filled the ring are taken out
+// of it, and the rest of the response still reads in order - whether more of
+// the response comes after them or not
+ESP8266_TEST(response_ring_ipd)
+{
+	ESP8266Client client;
+	CHECK(client.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+
+	static std::string response;
+	esp.onCommand("AT+CIFSR", [](VirtualESP8266 &e, const std::string &command, uint64_t at) {
+		(void)command;
+		e.respond(response.c_str(), at);
+		return true;
+	});
+	esp.onCommand("AT+PING", [](VirtualESP8266 &e, const std::string &command, uint64_t at) {
+		(void)command;
+		e.respond(response.c_str(), at);
+		return true;
+	});
+
+	for (size_t pad = ESP8266_RX_BUFFER_LEN; pad < 2 * ESP8266_RX_BUFFER_LEN; pad++)
+	{
+		response = std::string(pad, 'x') + "\r\n+CIFSR:STAIP,\"192.168.4.21\"\r\n" +
+				   "+IPD,0,5:hello+CIFSR:STAMAC,\"18:fe:34:9d:b7:d9\"\r\n\r\nOK\r\n";
+		CHECK(esp8266.localIP() == IPAddress(192, 168, 4, 21));
+		CHECK(readAll(client, 5) == "hello");
+
+		// (the ping gets no ERROR, so the frame is the last thing before the
+		// timeout)
+		response = std::string(pad, 'x') + "\r\n+timeout\r\n+IPD,0,5:world";
+		CHECK(esp8266.ping(IPAddress(10, 0, 0, 2)) == ESP8266_RSP_TIMEOUT);
+		CHECK(readAll(client, 5) == "world");
+	}
+}
+
+// with every link open to a long address the AT+CIPSTATUS response is
+// longer than the ring, and still every link is listed
+ESP8266_TEST(status_five_links)
+{
+	ESP8266Client clients[ESP8266_MAX_SOCK_NUM];
+	for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+	{
+		CHECK(clients[i].connect(IPAddress(192, 168, 100, 100 + i), 65530 + i) > 0);
+	}
+	CHECK(firstOpenLink(esp) == 0);
+
+	CHECK(esp8266.updateStatus() > 0);
+	for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+	{
+		CHECK(esp.link(i).open);
+		CHECK(esp8266._state[i] != AVAILABLE);
+		CHECK(clients[i].connected());
+	}
+	CHECK(esp8266.rxBufferOverflow() == 0);
+}
+
+// a command's result can still be read once poll() has gone on to send the
+// client data that was waiting behind it
+ESP8266_TEST(result_after_background_send)
+{
+	ESP8266Client client;
+	CHECK(client.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+	esp.onCommand("AT+PING", [](VirtualESP8266 &e, const std::string &command, uint64_t at) {
+		(void)e;
+		(void)command;
+		(void)at;
+		return true;
+	});
+
+	char server[] = "10.0.0.2";
+	int16_t handle = esp8266.pingAsync(server);
+	CHECK(handle > 0);
+	client.print("hello");
+	CHECK(waitFor([&] { return esp8266.commandResult(handle) != ESP8266_RSP_PENDING; }));
+	CHECK(esp8266.commandResult(handle) == ESP8266_RSP_TIMEOUT);
+
+	settle(200000);
+	CHECK(esp.link(0).bytesIn == 5);
+	CHECK(esp8266.commandResult(handle) == ESP8266_RSP_TIMEOUT);
+}
+
+// CONNECT and CLOSED keep the socket table and the accept queue up to date
+// without asking the module
+ESP8266_TEST(link_events)
+{
+	ESP8266Server server(80);
+	server.begin();
+	int a = esp.acceptConnection(IPAddress(10, 0, 0, 9), 50000);
+	int b = esp.acceptConnection(IPAddress(10, 0, 0, 10), 50001);
+	esp.deliver(a, "first", 5);
+	esp.deliver(b, "second", 6);
+	settle(100000);
+
+	// handed out in the order they connected
+	ESP8266Client first = server.available();
+	ESP8266Client second = server.available();
+	CHECK(first && second);
+	CHECK(readAll(first, 5) == "first");
+	CHECK(readAll(second, 6) == "second");
+
+	esp.clearLog();
+	esp.closeLink(a);
+	settle(100000);
+	CHECK(!first.connected());
+	CHECK(second.connected());
+	CHECK(esp8266._state[a] == 0);
+	CHECK(esp.commands().empty());
+}
+
+// an AT+CIPSTATUS response that didn't all make it (no STATUS: line, or a line
+// too long for the ring) only updates the links it lists - the others stay
+// taken, so the next connect doesn't land on a link that is still open
+ESP8266_TEST(status_partial_keeps_links)
+{
+	ESP8266Client clients[3];
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		CHECK(clients[i].connect(IPAddress(192, 168, 100, 100 + i), 65530 + i) > 0);
+	}
+
+	static const char *link1 = "+CIPSTATUS:1,\"TCP\",\"192.168.100.101\",65531,4097,0\r\n";
+	static std::string reply;
+	esp.onCommand("AT+CIPSTATUS", [](VirtualESP8266 &e, const std::string &command, uint64_t at) {
+		(void)command;
+		e.respond(reply.c_str(), at);
+		return true;
+	});
+
+	reply = std::string("STATUS:3\r\n") + std::string(ESP8266_RX_BUFFER_LEN + 10, 'x') + "\r\n" +
+			link1 + "\r\nOK\r\n";
+	CHECK(esp8266.updateStatus() > 0);
+	reply = std::string(link1) + "\r\nOK\r\n";
+	CHECK(esp8266.updateStatus() > 0);
+
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		CHECK(esp8266._state[i] != AVAILABLE);
+		CHECK(clients[i].connected());
+	}
+
+	ESP8266Client next;
+	CHECK(next.connect(IPAddress(10, 1, 1, 1), 80) > 0);
+	CHECK(esp.link(3).open && (esp.link(3).remoteIP == IPAddress(10, 1, 1, 1)));
+	CHECK(esp.link(0).remoteIP == IPAddress(192, 168, 100, 100));
+}
+
+// a complete response is a full resync - a link it doesn't list has gone,
+// and so has its place in the pool and the accept queue
+ESP8266_TEST(status_complete_frees_links)
+{
+	esp8266.setPoolSize(2);
+	ESP8266Client clients[3];
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		CHECK(clients[i].connect(IPAddress(10, 0, 0, 1 + i), 80) > 0);
+	}
+
+	// link 3 sits in the pool, and link 4 is waiting to be accepted
+	ESP8266Client pooled;
+	CHECK(pooled.connect(IPAddress(10, 0, 0, 4), 80) > 0);
+	pooled.stop();
+	ESP8266Server server(80);
+	server.begin();
+	CHECK(esp.acceptConnection(IPAddress(10, 0, 0, 9), 50000) == 4);
+	settle(100000);
+
+	esp.onCommand("AT+CIPSTATUS", [](VirtualESP8266 &e, const std::string &command, uint64_t at) {
+		(void)command;
+		e.respond("STATUS:3\r\n"
+				  "+CIPSTATUS:0,\"TCP\",\"10.0.0.1\",80,4097,0\r\n"
+				  "+CIPSTATUS:2,\"TCP\",\"10.0.0.3\",80,4099,0\r\n\r\nOK\r\n", at);
+		return true;
+	});
+	CHECK(esp8266.updateStatus() > 0);
+	CHECK(esp8266._state[0] != AVAILABLE);
+	CHECK(esp8266._state[1] == AVAILABLE);
+	CHECK(esp8266._state[2] != AVAILABLE);
+	CHECK(esp8266._state[3] == AVAILABLE);
+	CHECK(esp8266._state[4] == AVAILABLE);
+	CHECK(!clients[1].connected());
+
+	// the next connection is the first one handed out, and the next connect
+	// to where the pooled link went makes a new connection
+	esp.respond("1,CONNECT\r\n");
+	settle(10000);
+	CHECK(server.accept());
+	CHECK(!server.accept());
+	esp.respond("1,CLOSED\r\n");
+	settle(10000);
+	CHECK(countCommands(esp, "AT+CIPSTART") == 4);
+	CHECK(pooled.connect(IPAddress(10, 0, 0, 4), 80) > 0);
+	CHECK(countCommands(esp, "AT+CIPSTART") == 5);
+}
+
+// a payload bigger than a segment goes out as full segments and then what is
+// left, each with its own AT+CIPSEND
+ESP8266_TEST(send_segments)
+{
+	ESP8266Client client;
+	CHECK(client.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+	int link = firstOpenLink(esp);
+	CHECK(link >= 0);
+
+	std::string payload;
+	for (size_t i = 0; i < 2 * ESP8266_TCP_SEGMENT_SIZE + 80; i++)
+	{
+		payload += (char)('a' + (i % 26));
+	}
+	std::string sent;
+	esp.onData([&](uint8_t, const uint8_t *data, size_t size, uint64_t) {
+		sent.append((const char *)data, size);
+	});
+
+	char full[32];
+	sprintf(full, "AT+CIPSEND=%d,%d", link, ESP8266_TCP_SEGMENT_SIZE);
+	char last[32];
+	sprintf(last, "AT+CIPSEND=%d,80", link);
+	CHECK(esp8266.tcpSend(link, (const uint8_t *)payload.data(), payload.size()) == (int16_t)payload.size());
+	CHECK(countCommands(esp, "AT+CIPSEND") == 3);
+	CHECK(countCommands(esp, full) == 2);
+	CHECK(countCommands(esp, last) == 1);
+	CHECK(sent == payload);
+}
+
+// if a segment part of the way through fails, what got through before it is
+// what tcpSend() says was sent
+ESP8266_TEST(send_segments_failure)
+{
+	ESP8266Client client;
+	CHECK(client.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+	int link = firstOpenLink(esp);
+	CHECK(link >= 0);
+
+	// the second AT+CIPSEND is turned down
+	static int sends = 0;
+	esp.onCommand("AT+CIPSEND", [](VirtualESP8266 &e, const std::string &command, uint64_t at) {
+		(void)command;
+		if (++sends != 2)
+		{
+			return false;
+		}
+		e.respond("\r\nERROR\r\n", at);
+		return true;
+	});
+
+	std::string payload(2 * ESP8266_TCP_SEGMENT_SIZE + 80, 'x');
+	CHECK(esp8266.tcpSend(link, (const uint8_t *)payload.data(), payload.size()) == ESP8266_TCP_SEGMENT_SIZE);
+	CHECK(sends == 2);
+	CHECK((link >= 0) && (esp.link(link).bytesIn == ESP8266_TCP_SEGMENT_SIZE));
+}
+
+// a host is only looked up again once its address has been kept for the ttl
+// (or the cache is flushed) - connects by name use the cache too
+ESP8266_TEST(dns_cache)
+{
+	esp.addHost("broker.local", IPAddress(10, 0, 0, 9));
+	esp8266.setDnsTTL(1000);
+
+	IPAddress ip;
+	CHECK(esp8266.resolve("broker.local", ip) == ESP8266_RSP_SUCCESS);
+	CHECK(ip == IPAddress(10, 0, 0, 9));
+	CHECK(esp8266.resolve("broker.local", ip) == ESP8266_RSP_SUCCESS);
+	CHECK(countCommands(esp, "AT+CIPDOMAIN") == 1);
+
+	ESP8266Client client;
+	CHECK(client.connect("broker.local", 1883) > 0);
+	CHECK(countCommands(esp, "AT+CIPDOMAIN") == 1);
+	CHECK(countCommands(esp, "AT+CIPSTART=0,\"TCP\",\"10.0.0.9\",1883") == 1);
+
+	settle(1500000);
+	CHECK(esp8266.resolve("broker.local", ip) == ESP8266_RSP_SUCCESS);
+	CHECK(countCommands(esp, "AT+CIPDOMAIN") == 2);
+
+	esp8266.flushDnsCache();
+	CHECK(esp8266.resolve("broker.local", ip) == ESP8266_RSP_SUCCESS);
+	CHECK(countCommands(esp, "AT+CIPDOMAIN") == 3);
+}
+
+// when the lookup fails an expired address is still better than nothing
+ESP8266_TEST(dns_stale_fallback)
+{
+	esp.addHost("broker.local", IPAddress(10, 0, 0, 9));
+	esp8266.setDnsTTL(1000);
+
+	IPAddress ip;
+	CHECK(esp8266.resolve("broker.local", ip) == ESP8266_RSP_SUCCESS);
+	settle(1500000);
+
+	esp.onCommand("AT+CIPDOMAIN", [](VirtualESP8266 &e, const std::string &command, uint64_t at) {
+		(void)command;
+		e.respond("DNS Fail\r\n\r\nERROR\r\n", at);
+		return true;
+	});
+	ip = IPAddress(0, 0, 0, 0);
+	CHECK(esp8266.resolve("broker.local", ip) == ESP8266_RSP_SUCCESS);
+	CHECK(ip == IPAddress(10, 0, 0, 9));
+	CHECK(countCommands(esp, "AT+CIPDOMAIN") == 2);
+
+	// but a host we have never found still fails, and a connect to it isn't
+	// left to the module to look up all over again
+	CHECK(esp8266.resolve("other.local", ip) < 0);
+	ESP8266Client client;
+	CHECK(client.connect("other.local", 80) < 0);
+	CHECK(countCommands(esp, "AT+CIPDOMAIN") == 4);
+	CHECK(countCommands(esp, "AT+CIPSTART") == 0);
+	CHECK(esp8266._state[0] == AVAILABLE);
+}
+
+// a tcpConnectMany() while a buffered send is still going out has to wait for
+// it, not fail every target with busy
+ESP8266_TEST(connect_many_busy)
+{
+	ESP8266Client client;
+	CHECK(client.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+	client.print("hello");
+	hostAdvance(50000);
+
+	esp8266_connect_target targets[2] = {
+		{ ESP8266_SOCK_NOT_AVAIL, "10.0.0.2", 80, 0, 0 },
+		{ ESP8266_SOCK_NOT_AVAIL, "10.0.0.3", 80, 0, 0 }
+	};
+	CHECK(esp8266.tcpConnectMany(targets, 2) == 2);
+	CHECK(targets[0].result > 0);
+	CHECK(targets[1].result > 0);
+
+	settle(200000);
+	CHECK(esp.link(0).bytesIn == 5);
+}
+
+// every target gets its own result, and the ones that fail don't stop the
+// rest
+ESP8266_TEST(connect_many)
+{
+	esp.refuse(IPAddress(10, 0, 0, 3), 80);
+	esp8266_connect_target targets[3] = {
+		{ ESP8266_SOCK_NOT_AVAIL, "10.0.0.2", 80, 0, 0 },
+		{ ESP8266_SOCK_NOT_AVAIL, "10.0.0.3", 80, 0, 0 },
+		{ ESP8266_SOCK_NOT_AVAIL, "10.0.0.4", 80, 0, 0 }
+	};
+	CHECK(esp8266.tcpConnectMany(targets, 3) == 2);
+	CHECK(targets[0].result > 0);
+	CHECK(targets[1].result < 0);
+	CHECK(targets[2].result > 0);
+	CHECK(targets[0].linkID != targets[2].linkID);
+	CHECK((targets[0].linkID < ESP8266_MAX_SOCK_NUM) && esp.link(targets[0].linkID).open);
+	CHECK((targets[2].linkID < ESP8266_MAX_SOCK_NUM) && esp.link(targets[2].linkID).open);
+}
+
+// a target's link that someone else already has isn't touched, and a link
+// the batch took itself is given back if its AT+CIPSTART can't be sent
+ESP8266_TEST(connect_many_taken_link)
+{
+	ESP8266Client client;
+	CHECK(client.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+	int link = firstOpenLink(esp);
+	CHECK(link == 0);
+
+	std::string host(ESP8266_TX_BUFFER_LEN, 'h');
+	esp8266_connect_target targets[3] = {
+		{ 0, "10.0.0.2", 80, 0, 0 },
+		{ 2, host.c_str(), 80, 0, 0 },
+		{ 3, "10.0.0.4", 80, 0, 0 }
+	};
+	CHECK(esp8266.tcpConnectMany(targets, 3) == 1);
+	CHECK(targets[0].result == ESP8266_CMD_BAD);
+	CHECK(targets[1].result < 0);
+	CHECK(targets[2].result > 0);
+	CHECK(countCommands(esp, "AT+CIPSTART") == 2);
+	CHECK(esp8266._state[0] != AVAILABLE);
+	CHECK(esp8266._state[2] == AVAILABLE);
+	CHECK(client.connected());
+
+	// so the next connect takes link 1, and the one after link 2
+	ESP8266Client second;
+	ESP8266Client third;
+	CHECK(second.connect(IPAddress(10, 0, 0, 5), 80) > 0);
+	CHECK(third.connect(IPAddress(10, 0, 0, 6), 80) > 0);
+	CHECK(esp.link(0).remoteIP == IPAddress(10, 0, 0, 1));
+	CHECK(esp.link(2).remoteIP == IPAddress(10, 0, 0, 6));
+}
+
+// a tcpConnectMany() on another ESP8266Class carries on with that instance
+// as each connection finishes, not with esp8266
+ESP8266_TEST(connect_many_second_instance)
+{
+	ESP8266Class other;
+	CHECK(other.begin(115200, ESP8266_HARDWARE_SERIAL));
+
+	esp8266_connect_target targets[2] = {
+		{ ESP8266_SOCK_NOT_AVAIL, "10.0.0.2", 80, 0, 0 },
+		{ ESP8266_SOCK_NOT_AVAIL, "10.0.0.3", 80, 0, 0 }
+	};
+	CHECK(other.tcpConnectMany(targets, 2) == 2);
+	CHECK((targets[0].result > 0) && (targets[1].result > 0));
+	CHECK(!other.connectingMany());
+	CHECK(other._state[0] != AVAILABLE);
+	CHECK(other._state[1] != AVAILABLE);
+	CHECK(esp8266._state[0] == AVAILABLE);
+}
+
+#ifdef ESP8266_STATS
+
+// every command is counted by kind and result, with its latency in the
+// histogram, and the bytes both ways are counted exactly
+ESP8266_TEST(stats_commands)
+{
+	settle(100000);
+	esp8266.clearStats();
+
+	// the module answers a ping in 12ms ("+12")
+	CHECK(esp8266.ping(IPAddress(10, 0, 0, 1)) > 0);
+	esp8266_stats stats;
+	esp8266.stats(stats);
+	const esp8266_command_stats &ping = stats.command[ESP8266_STATS_PING];
+	CHECK(ping.issued == 1);
+	CHECK(ping.ok == 1);
+	CHECK((ping.error == 0) && (ping.timeout == 0) && (ping.unknown == 0));
+	CHECK((ping.maxLatency >= 12) && (ping.maxLatency < 16));
+	CHECK(ping.latency[4] == 1);
+	CHECK(stats.bytesOut == strlen("AT+PING=\"10.0.0.1\"\r\n"));
+	CHECK(stats.bytesIn == strlen("+12\r\n\r\nOK\r\n"));
+
+	// a refused connect is an error, and one that gets no answer times out
+	esp.refuse(IPAddress(10, 0, 0, 3), 80);
+	ESP8266Client client;
+	CHECK(client.connect(IPAddress(10, 0, 0, 3), 80) < 0);
+	// (as does one the module itself gives up on)
+	bool answer = true;
+	esp.onCommand("AT+PING", [&answer](VirtualESP8266 &e, const std::string &command, uint64_t at) {
+		(void)command;
+		if (answer)
+		{
+			e.respond("+timeout\r\n\r\nERROR\r\n", at);
+		}
+		return true;
+	});
+	CHECK(esp8266.ping(IPAddress(10, 0, 0, 1)) == ESP8266_RSP_TIMEOUT);
+	answer = false;
+	CHECK(esp8266.ping(IPAddress(10, 0, 0, 1)) == ESP8266_RSP_TIMEOUT);
+
+	// a command too long to send isn't counted against the last one sent
+	std::string name(ESP8266_TX_BUFFER_LEN, 'h');
+	CHECK(esp8266.ping(&name[0]) < 0);
+
+	esp8266.stats(stats);
+	CHECK(stats.command[ESP8266_STATS_CONNECT].issued == 1);
+	CHECK(stats.command[ESP8266_STATS_CONNECT].error == 1);
+	CHECK(stats.command[ESP8266_STATS_PING].issued == 3);
+	CHECK(stats.command[ESP8266_STATS_PING].ok == 1);
+	CHECK(stats.command[ESP8266_STATS_PING].timeout == 2);
+	CHECK(stats.command[ESP8266_STATS_OTHER].issued == 1);
+	uint16_t counted = 0;
+	for (uint8_t i = 0; i < ESP8266_STATS_BUCKETS; i++)
+	{
+		counted += stats.command[ESP8266_STATS_PING].latency[i];
+	}
+	CHECK(counted == 3);
+
+	// and the text version has the same numbers
+	StringPrint out;
+	esp8266.printStats(out);
+	CHECK(out.text.find("PING 3 1 0 2 0 ") != std::string::npos);
+	CHECK(out.text.find("CIPSTART 1 0 1 0 0 ") != std::string::npos);
+
+	esp8266.clearStats();
+	esp8266.stats(stats);
+	CHECK((stats.command[ESP8266_STATS_PING].issued == 0) && (stats.bytesOut == 0));
+}
+
+// each link's traffic is counted from when it opens - what is sent and
+// acknowledged, what arrives (and what is dropped because it didn't fit)
+ESP8266_TEST(stats_links)
+{
+	ESP8266Client client;
+	CHECK(client.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+	int link = firstOpenLink(esp);
+	CHECK(link >= 0);
+	if (link < 0)
+	{
+		return;
+	}
+
+	esp8266_link_stats links[ESP8266_MAX_SOCK_NUM];
+	esp8266.linkStats(links);
+	CHECK(links[link].open);
+	CHECK((links[link].bytesSent == 0) && (links[link].bytesReceived == 0));
+
+	client.print("hello");
+	client.flush();
+	settle(100000);
+	esp8266.linkStats(links);
+	CHECK(links[link].bytesSent == 5);
+	CHECK(links[link].segments == 1);
+	CHECK(links[link].acked == 1);
+	CHECK(links[link].maxRtt >= links[link].lastRtt);
+	CHECK(links[link].totalRtt == links[link].lastRtt);
+
+	// more than the link can hold - the rest is dropped
+	std::string reply(ESP8266_CLIENT_MAX_BUFFER_SIZE + 44, 'x');
+	esp.deliver(link, reply.data(), reply.size());
+	settle(100000);
+	esp8266.linkStats(links);
+	CHECK(links[link].bytesReceived == reply.size());
+	CHECK(links[link].rxHighWater == ESP8266_CLIENT_MAX_BUFFER_SIZE);
+	CHECK(links[link].rxDropped == 44);
+
+	CHECK(readAll(client, ESP8266_CLIENT_MAX_BUFFER_SIZE).size() == ESP8266_CLIENT_MAX_BUFFER_SIZE);
+	esp.deliver(link, "again", 5);
+	CHECK(readAll(client, 5) == "again");
+	esp8266.linkStats(links);
+	CHECK(links[link].bytesReceived == reply.size() + 5);
+	CHECK(links[link].rxHighWater == ESP8266_CLIENT_MAX_BUFFER_SIZE);
+
+	// once it closes its age stops, and the stats are kept until it opens
+	// again
+	settle(1000000);
+	esp.closeLink(link);
+	settle(100000);
+	esp8266.linkStats(links);
+	CHECK(!links[link].open);
+	CHECK(links[link].age >= 1000);
+	unsigned long age = links[link].age;
+	settle(1000000);
+	esp8266.linkStats(links);
+	CHECK(links[link].age == age);
+	CHECK(links[link].bytesSent == 5);
+
+	client.stop();
+	CHECK(client.connect(IPAddress(10, 0, 0, 1), 80) > 0);
+	esp8266.linkStats(links);
+	CHECK(links[link].open);
+	CHECK((links[link].bytesSent == 0) && (links[link].bytesReceived == 0));
+}
+
+#endif
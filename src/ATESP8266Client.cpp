@@ -24,6 +24,7 @@ date:   11/09/2020
 
 ESP8266Client::ESP8266Client()
 {
+	_socket = ESP8266_SOCK_NOT_AVAIL;
 }
 
 ESP8266Client::ESP8266Client(uint8_t sock)
@@ -61,15 +62,43 @@ int ESP8266Client::connect(IPAddress ip, uint16_t port, uint32_t keepAlive)
 	
 int ESP8266Client::connect(const char* host, uint16_t port, uint32_t keepAlive) 
 {
+	// a link to the same place that was kept open when its last client 
+	// stopped can be used straight away
+	_socket = esp8266.takePooledLink(host, port);
+	if (_socket != ESP8266_SOCK_NOT_AVAIL)
+	{
+		return 1;
+	}
+
+	// if every link is taken, give up the pooled link idle the longest
 	_socket = getFirstSocket();
+	if ((_socket == ESP8266_SOCK_NOT_AVAIL) && 
+		(esp8266.evictPooledLink() != ESP8266_SOCK_NOT_AVAIL))
+	{
+		_socket = getFirstSocket();
+	}
 	
     if (_socket != ESP8266_SOCK_NOT_AVAIL)
     {
 		esp8266._state[_socket] = TAKEN;
+		esp8266._sendBuffer.clear(_socket);
 		int16_t rsp = esp8266.tcpConnect(_socket, host, port, keepAlive);
+		if (rsp > 0)
+		{
+			esp8266.notePooledLink(_socket, host, port);
+		}
+		else if (esp8266._status.ipstatus[_socket].linkID == ESP8266_SOCK_NOT_AVAIL)
+		{
+			// the AT+CIPSTART may never have gone out, so nothing else will
+			// give the link back
+			esp8266._state[_socket] = AVAILABLE;
+		}
 		
 		return rsp;
 	}
+
+	// no free links
+	return 0;
 }
 
 size_t ESP8266Client::write(uint8_t c)
@@ -79,58 +108,100 @@ size_t ESP8266Client::write(uint8_t c)
 
 size_t ESP8266Client::write(const uint8_t *buf, size_t size)
 {
-	return esp8266.tcpSend(_socket, buf, size);
+	// writes are collected and sent together (see ATESP8266ClientWriteBuffer.h)
+	return esp8266._sendBuffer.write(_socket, buf, size);
+}
+
+void ESP8266Client::setNoDelay(bool nodelay)
+{
+	setWriteDelay(nodelay ? 0 : ESP8266_CLIENT_TX_DELAY);
+}
+
+void ESP8266Client::setWriteDelay(uint16_t ms)
+{
+	esp8266._sendBuffer.setDelay(_socket, ms);
+}
+
+void ESP8266Client::setBufferedSend(bool enable)
+{
+	// get anything already collected out using the old mode first
+	esp8266._sendBuffer.flush(_socket);
+	esp8266.setSendMode(_socket, enable ? ESP8266_SEND_BUFFERED : ESP8266_SEND_DIRECT);
+}
+
+int ESP8266Client::availableForWrite()
+{
+	// nothing more is going anywhere if the last send failed
+	if (esp8266._sendBuffer.error(_socket) < 0)
+	{
+		return 0;
+	}
+
+	// room in the module, less what we are already holding on to for it
+	int room = esp8266.availableForWrite(_socket) - esp8266._sendBuffer.pending(_socket);
+	return (room > 0) ? room : 0;
+}
+
+bool ESP8266Client::overflowed()
+{
+	// pick up anything the uart already has first
+	esp8266.poll();
+	return esp8266._receiveBuffer.overflowed(_socket);
 }
 
 int ESP8266Client::available()
 {
-	return receiveBuffer.available();
+	return esp8266._receiveBuffer.available(_socket);
 }
 
 int ESP8266Client::read()
 {
-	return receiveBuffer.read();
+	return esp8266._receiveBuffer.read(_socket);
 }
 
 int ESP8266Client::read(uint8_t *buf, size_t size)
 {
-	if (available() + esp8266.available() < size)
-		return 0;
-	
-	for (int i=0; i<size; i++)
-	{
-		buf[i] = this->read();
-	}
-	
-	return 1;
+	// give back however much is available (up to size), copied straight out
+	// of the receive buffer
+	return esp8266._receiveBuffer.read(_socket, buf, size);
 }
 
 int ESP8266Client::peek()
 {
-	return esp8266.peek();
+	return esp8266._receiveBuffer.peek(_socket);
 }
 
 void ESP8266Client::flush()
 {
-	esp8266.flush();
+	esp8266._sendBuffer.flush(_socket);
 }
 
 void ESP8266Client::stop()
 {
+	// send anything still waiting before we close the link (or put it in
+	// the pool for the next connect() to the same place)
+	esp8266._sendBuffer.flush(_socket);
+	if (esp8266.releaseLink(_socket))
+	{
+		_socket = ESP8266_SOCK_NOT_AVAIL;
+		return;
+	}
 	esp8266.close(_socket);
-	esp8266._state[_socket] = AVAILABLE;
+	if (_socket < ESP8266_MAX_SOCK_NUM)
+	{
+		esp8266._state[_socket] = AVAILABLE;
+	}
 }
 
 uint8_t ESP8266Client::connected()
 {
-	// If data is available, assume we're connected. Otherwise,
-	// we'll try to send the status query, and will probably end 
-	// up timing out if data is still coming in.
-	if (_socket == ESP8266_SOCK_NOT_AVAIL)
+	// If data is available, assume we're connected. Otherwise check the 
+	// socket table (available() has already picked up any CLOSED event)
+	if (_socket >= ESP8266_MAX_SOCK_NUM)
 		return 0;
 	else if (available() > 0)
 		return 1;
-	else if (esp8266._status.stat == ESP8266_STATUS_CONNECTED)
+	else if (esp8266._status.ipstatus[_socket].linkID == _socket)
 		return 1;
 	
 	return 0;
@@ -144,7 +215,9 @@ ESP8266Client::operator bool()
 // Private Methods
 uint8_t ESP8266Client::getFirstSocket()
 {
-	/*
+	// the socket table is kept up to date by the link events, so we just
+	// need to pick up any that are waiting
+	esp8266.poll();
 	for (int i = 0; i < ESP8266_MAX_SOCK_NUM; i++) 
 	{
 		if (esp8266._state[i] == AVAILABLE)
@@ -153,14 +226,4 @@ uint8_t ESP8266Client::getFirstSocket()
 		}
 	}
 	return ESP8266_SOCK_NOT_AVAIL;
-	*/
-	esp8266.updateStatus();
-	for (int i = 0; i < ESP8266_MAX_SOCK_NUM; i++) 
-	{
-		if (esp8266._status.ipstatus[i].linkID == 255)
-		{
-			return i;
-		}
-	}
-	return ESP8266_SOCK_NOT_AVAIL;
 }
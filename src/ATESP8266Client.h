@@ -26,9 +26,6 @@ Distributed as-is; no warranty is given.
 #include <IPAddress.h>
 #include "Client.h"
 #include "ATESP8266WiFi.h"
-#include "ATESP8266ClientReadBuffer.h"
-
-#define ESP8266_CLIENT_MAX_BUFFER_SIZE 256
 
 class ESP8266Client : public Client {
 	
@@ -56,12 +53,34 @@ public:
 	virtual uint8_t connected();
 	virtual operator bool();
 
+	/// setNoDelay([nodelay]) - Send every write straight away rather than
+	/// collecting them (like TCP_NODELAY)
+	void setNoDelay(bool nodelay);
+
+	/// setWriteDelay([ms]) - How long the link can be idle before collected
+	/// writes are sent
+	void setWriteDelay(uint16_t ms);
+
+	/// setBufferedSend([enable]) - Let the module queue several segments
+	/// (AT+CIPSENDBUF) rather than waiting for each SEND OK
+	void setBufferedSend(bool enable);
+
+	/// availableForWrite() - Bytes that can be written before a write has
+	/// to wait for the module to send what it has (0 once a send on the
+	/// link has failed, until the next write() or flush() reports it)
+	virtual int availableForWrite();
+
+	/// overflowed() - True if data has arrived that there was no room for
+	/// (because it wasn't read quickly enough) and been thrown away, so what
+	/// read() gives back has a gap in it. Stays true until the next 
+	/// connect().
+	bool overflowed();
+
 	friend class WiFiServer;
 
 	using Print::write;
 
 private:
-	ESP8266ClientReadBuffer receiveBuffer;
 	static uint16_t _srcport;
 	uint16_t  _socket;
 	bool ipMuxEn;
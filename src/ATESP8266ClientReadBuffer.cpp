@@ -1,7 +1,7 @@
 /**
 ATESP8266ClientReadBuffer.cpp
 
-Arduino library for managing wifi connections using an ESP8266 in AT mode 
+Arduino library for managing wifi connections using an ESP8266 in AT mode
 (using AT firmware v1.3.0).
 
 The Sparkfun ESP8266 client library just uses a Serial.read() to get the data
@@ -20,93 +20,453 @@ date:   11/09/2020
 #include "ATESP8266WiFi.h"
 #include "ATESP8266ClientReadBuffer.h"
 
-int ESP8266ClientReadBuffer::available()
+ESP8266ClientReadBuffer::ESP8266ClientReadBuffer()
 {
-	// client has already buffered some payload
-	if (receiveBufferSize > 0)
+	for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+	{
+		receiveBufferHead[i] = 0;
+		receiveBufferSize[i] = 0;
+	}
+	receiveBufferDropped = 0;
+	receiveBufferOverflow = 0;
+	frameActive = false;
+	frameState = ESP8266_FRAME_LINK;
+
+	datagramHead = 0;
+	datagramCount = 0;
+	datagramLinks = 0;
+	frameDatagram = ESP8266_UDP_MAX_DATAGRAMS;
+}
+
+int ESP8266ClientReadBuffer::available(uint8_t linkID)
+{
+	if (linkID >= ESP8266_MAX_SOCK_NUM)
 	{
-		return receiveBufferSize;
+		return 0;
 	}
 
-	// check if data is available
-	int available = esp8266.available();
-	if (available == 0)
+	// client has already buffered some payload
+	if (receiveBufferSize[linkID] > 0)
 	{
-		// delay for the amount of time it'd take to receive one character
-		delayMicroseconds((1 / esp8266._baud) * 10 * 1E6);
-		// check again just to be sure
-		available = esp8266.available();
+		return receiveBufferSize[linkID];
 	}
-	return available; //esp8266.available();
+
+	// otherwise see if the esp8266 has anything new for us
+	esp8266.poll();
+	return receiveBufferSize[linkID];
 }
 
-int ESP8266ClientReadBuffer::read()
+int ESP8266ClientReadBuffer::read(uint8_t linkID)
 {
-	// append to buffer BEFORE we read, so that chances are higher to detect AT commands
-	this->fillReceiveBuffer();
+	if (linkID >= ESP8266_MAX_SOCK_NUM)
+	{
+		return -1;
+	}
+
+	// append to buffer BEFORE we read
+	this->fillReceiveBuffer(linkID);
 
-	// read from buffer
-	if (receiveBufferSize > 0) {
-		uint8_t ret = receiveBuffer[0];
-		this->truncateReceiveBufferHead(0, 1);
+	// read from the head of the ring
+	if (receiveBufferSize[linkID] > 0) {
+		uint8_t ret = receiveBuffer[linkID][receiveBufferHead[linkID]];
+		receiveBufferHead[linkID] = (receiveBufferHead[linkID] + 1) % ESP8266_CLIENT_MAX_BUFFER_SIZE;
+		receiveBufferSize[linkID]--;
 		return ret;
 	}
 
 	return -1;
 }
 
-void ESP8266ClientReadBuffer::truncateReceiveBufferHead(uint8_t startingOffset, uint8_t truncateLength) 
+size_t ESP8266ClientReadBuffer::read(uint8_t linkID, uint8_t *buf, size_t size)
 {
-	// shift buffer content; todo: better implementation
-	for (uint8_t i = startingOffset; i < receiveBufferSize - truncateLength; i++)
+	if (linkID >= ESP8266_MAX_SOCK_NUM)
+	{
+		return 0;
+	}
+
+	// append to buffer BEFORE we read
+	this->fillReceiveBuffer(linkID);
+
+	size_t total = 0;
+	while (total < size)
 	{
-		receiveBuffer[i] = receiveBuffer[i + truncateLength];
+		size_t count = this->copyReceiveBuffer(linkID, buf + total, size - total);
+		if (count == 0)
+		{
+			break;
+		}
+		total += count;
+
+		// pick up anything more that has arrived while we were copying
+		esp8266.poll();
 	}
-	receiveBufferSize -= truncateLength;
+
+	return total;
+}
+
+size_t ESP8266ClientReadBuffer::copyReceiveBuffer(uint8_t linkID, uint8_t *buf, size_t size)
+{
+	// copy out as much as we have (up to size) - the data can wrap round the
+	// end of the ring, so this takes at most two copies
+	uint16_t head = receiveBufferHead[linkID];
+	size_t count = min((size_t)receiveBufferSize[linkID], size);
+	size_t first = min(count, (size_t)(ESP8266_CLIENT_MAX_BUFFER_SIZE - head));
+
+	memcpy(buf, &receiveBuffer[linkID][head], first);
+	memcpy(buf + first, &receiveBuffer[linkID][0], count - first);
+
+	receiveBufferHead[linkID] = (head + count) % ESP8266_CLIENT_MAX_BUFFER_SIZE;
+	receiveBufferSize[linkID] -= count;
+	return count;
 }
 
-void ESP8266ClientReadBuffer::fillReceiveBuffer() 
+int ESP8266ClientReadBuffer::peek(uint8_t linkID)
 {
-	// fill the receive buffer as much as possible from esp8266.read()
-	for (uint8_t attemps = 0; attemps < 5; attemps++) 
-	{		
-		// often 1st available() call does not yield all bytes => outer while
-		while (uint8_t availableBytes = esp8266.available() > 0) 
+	if ((linkID >= ESP8266_MAX_SOCK_NUM) || (available(linkID) == 0))
+	{
+		return -1;
+	}
+	return receiveBuffer[linkID][receiveBufferHead[linkID]];
+}
+
+void ESP8266ClientReadBuffer::clear(uint8_t linkID)
+{
+	if (linkID < ESP8266_MAX_SOCK_NUM)
+	{
+		receiveBufferHead[linkID] = 0;
+		receiveBufferSize[linkID] = 0;
+		receiveBufferOverflow &= ~(1 << linkID);
+
+		// the datagrams went with the data
+		for (int8_t i = datagramCount - 1; i >= 0; i--)
 		{
-			for (; availableBytes > 0 && receiveBufferSize < ESP8266_CLIENT_MAX_BUFFER_SIZE; availableBytes--) 
+			if (datagram[(datagramHead + i) % ESP8266_UDP_MAX_DATAGRAMS].link == linkID)
 			{
-				receiveBuffer[receiveBufferSize++] = esp8266.read();
+				removeDatagram(i);
 			}
-			delay(10);
 		}
-		delay(10);
 	}
+}
 
-	// strip the AT nonsense out of the read data - we only want the payload!
-	this->cleanReceiveBufferFromAT();
+unsigned long ESP8266ClientReadBuffer::dropped()
+{
+	return receiveBufferDropped;
+}
+
+bool ESP8266ClientReadBuffer::overflowed(uint8_t linkID)
+{
+	if (linkID >= ESP8266_MAX_SOCK_NUM)
+	{
+		return false;
+	}
+	return (receiveBufferOverflow & (1 << linkID)) != 0;
 }
 
-void ESP8266ClientReadBuffer::cleanReceiveBufferFromAT() 
+size_t ESP8266ClientReadBuffer::discard(uint8_t linkID, size_t size)
 {
-	// typical response from AT+CIPSEND looks like \r\n\r\n+IPD,0,4:<payload>
-	// get rid of these esp8266 commands
-	this->cleanReceiveBufferFromAT("\r\n\r\n+IPD", 5);
+	if (linkID >= ESP8266_MAX_SOCK_NUM)
+	{
+		return 0;
+	}
 
-	// though ... it looks like there might be only \r\n when we get a 
-	// continuation of the payload (i.e. it is split across multiple packets)
+	size_t count = min((size_t)receiveBufferSize[linkID], size);
+	receiveBufferHead[linkID] = (receiveBufferHead[linkID] + count) % ESP8266_CLIENT_MAX_BUFFER_SIZE;
+	receiveBufferSize[linkID] -= count;
+	return count;
 }
 
-void ESP8266ClientReadBuffer::cleanReceiveBufferFromAT(const char *atCommand, uint8_t additionalSuffixToKill) 
+void ESP8266ClientReadBuffer::fillReceiveBuffer(uint8_t linkID)
 {
-	uint8_t atLen = strlen(atCommand);
-	for (uint8_t offset = 0; offset <= receiveBufferSize - atLen; offset++) 
+	// get the esp8266 to move whatever the uart already has into the link
+	// buffers (this doesn't wait for anything)
+	esp8266.poll();
+
+	// if we have run out but the rest of a frame for this link is on its way,
+	// wait for it - but only as long as the gap between bytes at this baud
+	// rate could be (10 bits per byte)
+	if ((receiveBufferSize[linkID] > 0) || !frameIncomplete(linkID) || (esp8266._baud == 0))
+	{
+		return;
+	}
+
+	unsigned long gap = (10000000UL / esp8266._baud) * ESP8266_CLIENT_GAP_CHARS;
+	unsigned long lastByte = micros();
+	while ((receiveBufferSize[linkID] == 0) && frameIncomplete(linkID))
 	{
-		if (0 == memcmp((receiveBuffer + offset), atCommand, atLen)) 
+		if (esp8266._serial->available() > 0)
+		{
+			esp8266.poll();
+			lastByte = micros();
+		}
+		else if (micros() - lastByte > gap)
 		{
-			// found the at command. KILL IT!
-			this->truncateReceiveBufferHead(offset, atLen + additionalSuffixToKill);
 			break;
 		}
 	}
 }
 
+//////////////////
+// Frame Parser //
+//////////////////
+
+void ESP8266ClientReadBuffer::beginFrame()
+{
+	frameActive = true;
+	frameState = ESP8266_FRAME_LINK;
+	frameLink = 0;
+	frameLength = 0;
+	memset(frameIP, 0, sizeof(frameIP));
+	frameInfoField = 0;
+	framePort = 0;
+}
+
+bool ESP8266ClientReadBuffer::frameByte(uint8_t c)
+{
+	frameActive = parseFrameByte(c);
+	return frameActive;
+}
+
+bool ESP8266ClientReadBuffer::parseFrameByte(uint8_t c)
+{
+	switch (frameState)
+	{
+	case ESP8266_FRAME_LINK:
+		// with multiple connections enabled the first number is the link ID,
+		// otherwise it is the length (and the header ends at the ':')
+		if ((c >= '0') && (c <= '9'))
+		{
+			frameLength = (frameLength * 10) + (c - '0');
+			return true;
+		}
+		else if (c == ',')
+		{
+			frameLink = frameLength;
+			frameLength = 0;
+			frameState = ESP8266_FRAME_LENGTH;
+			return (frameLink < ESP8266_MAX_SOCK_NUM);
+		}
+		else if (c == ':')
+		{
+			break;
+		}
+		return false;
+
+	case ESP8266_FRAME_LENGTH:
+		if ((c >= '0') && (c <= '9'))
+		{
+			frameLength = (frameLength * 10) + (c - '0');
+			return true;
+		}
+		else if (c == ',')
+		{
+			// +CIPDINFO adds the remote ip and port before the ':'
+			frameState = ESP8266_FRAME_INFO;
+			return true;
+		}
+		else if (c == ':')
+		{
+			break;
+		}
+		return false;
+
+	case ESP8266_FRAME_INFO:
+		// <remote IP>,<remote port> (e.g. 192.168.0.10,5000)
+		if ((c >= '0') && (c <= '9'))
+		{
+			if (frameInfoField < 4)
+			{
+				frameIP[frameInfoField] = (frameIP[frameInfoField] * 10) + (c - '0');
+			}
+			else
+			{
+				framePort = (framePort * 10) + (c - '0');
+			}
+		}
+		else if ((c == '.') && (frameInfoField < 3))
+		{
+			frameInfoField++;
+		}
+		else if (c == ',')
+		{
+			frameInfoField = 4;
+		}
+		else if (c == ':')
+		{
+			break;
+		}
+		return true;
+
+	case ESP8266_FRAME_PAYLOAD:
+		// copy exactly the number of bytes in the header - whatever they are
+		// (datagrams that we have nowhere to keep track of, or that won't
+		// fit, are dropped)
+#ifdef ESP8266_STATS
+		esp8266._linkStats[frameLink].bytesReceived++;
+#endif
+		if (((datagramLinks & (1 << frameLink)) == 0) || (frameDatagram < ESP8266_UDP_MAX_DATAGRAMS))
+		{
+			if (receiveBufferSize[frameLink] < ESP8266_CLIENT_MAX_BUFFER_SIZE)
+			{
+				uint16_t tail = (receiveBufferHead[frameLink] + receiveBufferSize[frameLink]) % ESP8266_CLIENT_MAX_BUFFER_SIZE;
+				receiveBuffer[frameLink][tail] = c;
+				receiveBufferSize[frameLink]++;
+#ifdef ESP8266_STATS
+				if (receiveBufferSize[frameLink] > esp8266._linkStats[frameLink].rxHighWater)
+				{
+					esp8266._linkStats[frameLink].rxHighWater = receiveBufferSize[frameLink];
+				}
+#endif
+				if (frameDatagram < ESP8266_UDP_MAX_DATAGRAMS)
+				{
+					datagram[frameDatagram].length++;
+				}
+			}
+			else
+			{
+				// (a datagram only gets here if it fit, so this is a gap in
+				// a tcp stream)
+				receiveBufferDropped++;
+				receiveBufferOverflow |= (1 << frameLink);
+#ifdef ESP8266_STATS
+				esp8266._linkStats[frameLink].rxDropped++;
+#endif
+			}
+		}
+		else
+		{
+			receiveBufferDropped++;
+#ifdef ESP8266_STATS
+			esp8266._linkStats[frameLink].rxDropped++;
+#endif
+		}
+
+		if (--frameRemaining > 0)
+		{
+			return true;
+		}
+		break;
+	}
+
+	if (frameState != ESP8266_FRAME_PAYLOAD)
+	{
+		// got to the ':' at the end of the header
+		frameRemaining = frameLength;
+		frameState = ESP8266_FRAME_PAYLOAD;
+		if (datagramLinks & (1 << frameLink))
+		{
+			// a datagram that won't fit is dropped whole - a truncated one
+			// would look just like a complete (shorter) one
+			if (frameLength <= ESP8266_CLIENT_MAX_BUFFER_SIZE - receiveBufferSize[frameLink])
+			{
+				startDatagram();
+			}
+			else
+			{
+				frameDatagram = ESP8266_UDP_MAX_DATAGRAMS;
+			}
+		}
+		if (frameRemaining > 0)
+		{
+			return true;
+		}
+	}
+
+	// end of the frame - the datagram can be read now
+	if (frameDatagram < ESP8266_UDP_MAX_DATAGRAMS)
+	{
+		datagram[frameDatagram].complete = true;
+		frameDatagram = ESP8266_UDP_MAX_DATAGRAMS;
+	}
+	return false;
+}
+
+bool ESP8266ClientReadBuffer::frameIncomplete(uint8_t linkID)
+{
+	// while we are still in the header we don't know which link it is for
+	return frameActive && ((frameState != ESP8266_FRAME_PAYLOAD) || (frameLink == linkID));
+}
+
+///////////////
+// Datagrams //
+///////////////
+
+void ESP8266ClientReadBuffer::setDatagram(uint8_t linkID, bool enable)
+{
+	if (linkID >= ESP8266_MAX_SOCK_NUM)
+	{
+		return;
+	}
+
+	if (enable)
+	{
+		datagramLinks |= (1 << linkID);
+	}
+	else
+	{
+		datagramLinks &= ~(1 << linkID);
+	}
+	clear(linkID);
+}
+
+bool ESP8266ClientReadBuffer::takeDatagram(uint8_t linkID, esp8266_datagram & next)
+{
+	// datagrams for each link are in the order they arrived
+	for (uint8_t i = 0; i < datagramCount; i++)
+	{
+		esp8266_datagram & entry = datagram[(datagramHead + i) % ESP8266_UDP_MAX_DATAGRAMS];
+		if (entry.link == linkID)
+		{
+			if (!entry.complete)
+			{
+				return false;
+			}
+			next = entry;
+			removeDatagram(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+void ESP8266ClientReadBuffer::startDatagram()
+{
+	if (datagramCount >= ESP8266_UDP_MAX_DATAGRAMS)
+	{
+		frameDatagram = ESP8266_UDP_MAX_DATAGRAMS;
+		return;
+	}
+
+	frameDatagram = (datagramHead + datagramCount) % ESP8266_UDP_MAX_DATAGRAMS;
+	datagramCount++;
+
+	esp8266_datagram & entry = datagram[frameDatagram];
+	entry.link = frameLink;
+	entry.complete = false;
+	entry.length = 0;
+	memcpy(entry.remoteIP, frameIP, sizeof(frameIP));
+	entry.remotePort = framePort;
+}
+
+void ESP8266ClientReadBuffer::removeDatagram(uint8_t index)
+{
+	// the datagram the current frame is going into is always the newest
+	bool current = (frameDatagram < ESP8266_UDP_MAX_DATAGRAMS);
+	if (current && (index == datagramCount - 1))
+	{
+		current = false;
+		frameDatagram = ESP8266_UDP_MAX_DATAGRAMS;
+	}
+
+	// close up the gap, keeping everything else in order
+	for (uint8_t i = index; i + 1 < datagramCount; i++)
+	{
+		datagram[(datagramHead + i) % ESP8266_UDP_MAX_DATAGRAMS] = 
+			datagram[(datagramHead + i + 1) % ESP8266_UDP_MAX_DATAGRAMS];
+	}
+	datagramCount--;
+
+	if (current)
+	{
+		frameDatagram = (datagramHead + datagramCount - 1) % ESP8266_UDP_MAX_DATAGRAMS;
+	}
+}
@@ -1,7 +1,7 @@
 /**
 ATESP8266ClientReadBuffer.h
 
-Arduino library for managing wifi connections using an ESP8266 in AT mode 
+Arduino library for managing wifi connections using an ESP8266 in AT mode
 (using AT firmware v1.3.0).
 
 The Sparkfun ESP8266 client library just uses a Serial.read() to get the data
@@ -13,6 +13,11 @@ like:
 
 To make this work properly, we need to strip this stuff out of the response :)
 
+The ESP8266 event dispatcher hands every +IPD frame to this buffer, which
+parses the header and then copies exactly n bytes of payload into the buffer
+for that link - so the payload is never searched for AT commands and every
+link (client) gets its own data.
+
 author: Alex Shenfield
 date:   11/09/2020
 */
@@ -22,43 +27,132 @@ date:   11/09/2020
 
 #include <Arduino.h>
 
+// bytes of received payload buffered for each link (define this before
+// including the library to change it). every link has its own buffer, so on
+// an avr the five of them together take 320 bytes - a little more than the
+// single 256 byte buffer all the links used to share, but each link can only
+// hold 64 bytes that haven't been read. a sketch that only uses one or two
+// links can make this bigger, and anything that doesn't fit is reported by
+// ESP8266Client::overflowed()
+#ifndef ESP8266_CLIENT_MAX_BUFFER_SIZE
+#if defined(__AVR__)
+#define ESP8266_CLIENT_MAX_BUFFER_SIZE 64
+#else
 #define ESP8266_CLIENT_MAX_BUFFER_SIZE 256
+#endif
+#endif
+
+// when a frame has only partly arrived, read() waits for the rest for up to
+// this many character times (at the configured baud rate) between bytes
+#ifndef ESP8266_CLIENT_GAP_CHARS
+#define ESP8266_CLIENT_GAP_CHARS 4
+#endif
+
+// UDP links keep track of where each datagram starts and ends (and who sent
+// it) - this is how many datagrams can be waiting across all the links
+#ifndef ESP8266_UDP_MAX_DATAGRAMS
+#define ESP8266_UDP_MAX_DATAGRAMS 4
+#endif
 
 // so we have a potential problem here - the max packet size is ~1450 bytes ...
-// that means we have a tendency to lose data here
+// that means we have a tendency to lose data here. it can't be left in the
+// uart until the client has read what we have got, as every other link's data
+// (and every CONNECT and CLOSED) is queued up behind it - so whatever doesn't
+// fit is thrown away, counted in dropped(), and the link is marked as having
+// overflowed (so the client knows its stream has a gap in it)
+
+enum esp8266_frame_state {
+	ESP8266_FRAME_LINK,
+	ESP8266_FRAME_LENGTH,
+	ESP8266_FRAME_INFO,
+	ESP8266_FRAME_PAYLOAD
+};
+
+struct esp8266_datagram
+{
+	uint8_t link;
+	bool complete;
+	uint16_t length;
+	uint8_t remoteIP[4];
+	uint16_t remotePort;
+};
 
 class ESP8266ClientReadBuffer {
 
 public:
-	int available();
-	int read();
+	ESP8266ClientReadBuffer();
+
+	int available(uint8_t linkID);
+	int read(uint8_t linkID);
+	size_t read(uint8_t linkID, uint8_t *buf, size_t size);
+	int peek(uint8_t linkID);
+	void clear(uint8_t linkID);
+
+	/// beginFrame() - Start parsing a frame (the "+IPD," has been seen)
+	void beginFrame();
+
+	/// frameByte([c]) - Feed the next byte of the frame to the parser
+	/// Returns true while the frame needs more bytes
+	bool frameByte(uint8_t c);
+
+	/// frameIncomplete([linkID]) - True if part of a frame that could be for
+	/// [linkID] has arrived but the rest hasn't
+	bool frameIncomplete(uint8_t linkID);
+
+	/// dropped() - Number of payload bytes thrown away because the link's
+	/// buffer was full
+	unsigned long dropped();
+
+	/// overflowed([linkID]) - True if any of the link's tcp data has been
+	/// thrown away since it was last cleared (when the link opens)
+	bool overflowed(uint8_t linkID);
+
+	/// discard([linkID], [size]) - Throw away up to [size] buffered bytes
+	size_t discard(uint8_t linkID, size_t size);
+
+	/// setDatagram([linkID], [enable]) - Keep the boundaries of each +IPD
+	/// frame on the link (for UDP). A datagram that won't fit in what is
+	/// left of the link's buffer is dropped whole (and counted in dropped()),
+	/// never cut short.
+	void setDatagram(uint8_t linkID, bool enable);
+
+	/// takeDatagram([linkID], [datagram]) - Get the length and sender of
+	/// the next datagram for the link (its payload is next in the buffer)
+	/// Returns false if no complete datagram has arrived
+	bool takeDatagram(uint8_t linkID, esp8266_datagram & datagram);
 
 protected:
-	char receiveBufferSize = 0;
-	uint8_t receiveBuffer[ESP8266_CLIENT_MAX_BUFFER_SIZE];
+	// each link's buffer is a ring - head is the next byte to read and size
+	// is how many bytes are waiting
+	uint16_t receiveBufferHead[ESP8266_MAX_SOCK_NUM];
+	uint16_t receiveBufferSize[ESP8266_MAX_SOCK_NUM];
+	uint8_t receiveBuffer[ESP8266_MAX_SOCK_NUM][ESP8266_CLIENT_MAX_BUFFER_SIZE];
+	unsigned long receiveBufferDropped;
+	uint8_t receiveBufferOverflow;
 
-	void fillReceiveBuffer();
-	void truncateReceiveBufferHead(uint8_t startingOffset, uint8_t truncateLength);
-	void cleanReceiveBufferFromAT();
-	void cleanReceiveBufferFromAT(const char *atCommand, uint8_t additionalSuffixToKill);
-};
+	// +IPD,<link ID>,<len>[,<remote IP>,<remote port>]:<payload>
+	bool frameActive;
+	esp8266_frame_state frameState;
+	uint8_t frameLink;
+	uint16_t frameLength;
+	uint16_t frameRemaining;
+	uint8_t frameIP[4];
+	uint8_t frameInfoField;
+	uint16_t framePort;
 
-/*
-class CircularBuffer
-{
-public:
-    CircularBuffer( uint16_t inputSize );
-	~CircularBuffer();
-    int16_t getElement( uint16_t ); //zero is the push location
-    void pushElement( int16_t );
-    int16_t averageLast( uint16_t );
-    uint16_t recordLength( void );
-private:
-	uint16_t cBufferSize;
-    int16_t *cBufferData;
-    int16_t cBufferLastPtr;
-    uint8_t cBufferElementsUsed;
+	// datagrams waiting to be read (oldest first), and the one the current
+	// frame is going into (ESP8266_UDP_MAX_DATAGRAMS if it is being dropped)
+	esp8266_datagram datagram[ESP8266_UDP_MAX_DATAGRAMS];
+	uint8_t datagramHead;
+	uint8_t datagramCount;
+	uint8_t datagramLinks;
+	uint8_t frameDatagram;
+
+	bool parseFrameByte(uint8_t c);
+	void startDatagram();
+	void removeDatagram(uint8_t index);
+	void fillReceiveBuffer(uint8_t linkID);
+	size_t copyReceiveBuffer(uint8_t linkID, uint8_t *buf, size_t size);
 };
-*/
 
 #endif
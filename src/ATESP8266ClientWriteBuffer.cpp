@@ -0,0 +1,227 @@
+/**
+ATESP8266ClientWriteBuffer.cpp
+
+Arduino library for managing wifi connections using an ESP8266 in AT mode
+(using AT firmware v1.3.0).
+
+Collects the writes for each link so they can be sent with one AT+CIPSEND.
+See ATESP8266ClientWriteBuffer.h for details.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "ATESP8266WiFi.h"
+#include "ATESP8266ClientWriteBuffer.h"
+
+ESP8266ClientWriteBuffer::ESP8266ClientWriteBuffer()
+{
+	for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+	{
+		sendBufferSize[i] = 0;
+		sendDelay[i] = ESP8266_CLIENT_TX_DELAY;
+		lastWrite[i] = 0;
+		sendError[i] = 0;
+	}
+	sendingLink = ESP8266_SOCK_NOT_AVAIL;
+	flushing = false;
+}
+
+size_t ESP8266ClientWriteBuffer::write(uint8_t linkID, const uint8_t *buf, size_t size)
+{
+	if (linkID >= ESP8266_MAX_SOCK_NUM)
+	{
+		return 0;
+	}
+
+	// we can't add to the buffer while it is being sent
+	waitForLink(linkID);
+
+	// the data before this never made it, so neither will this
+	if (takeError(linkID) < 0)
+	{
+		sendBufferSize[linkID] = 0;
+		return 0;
+	}
+
+	// keep track of how much of this write has actually gone out, so if a
+	// send fails we only report what made it (earlier writes still in the
+	// buffer go out first)
+	size_t earlier = sendBufferSize[linkID];
+	size_t written = 0;
+	size_t sent = 0;
+	while (written < size)
+	{
+		// buffer full - send it before carrying on
+		if (sendBufferSize[linkID] == ESP8266_CLIENT_TX_BUFFER_SIZE)
+		{
+			if (!flushAll(linkID, earlier, sent))
+			{
+				return sent;
+			}
+			sent = written;
+			earlier = 0;
+		}
+
+		size_t count = min(size - written, (size_t)(ESP8266_CLIENT_TX_BUFFER_SIZE - sendBufferSize[linkID]));
+		memcpy(&sendBuffer[linkID][sendBufferSize[linkID]], buf + written, count);
+		sendBufferSize[linkID] += count;
+		written += count;
+	}
+	lastWrite[linkID] = millis();
+
+	// with no delay everything goes straight away
+	if ((sendDelay[linkID] == 0) && !flushAll(linkID, earlier, sent))
+	{
+		return sent;
+	}
+
+	return written;
+}
+
+// flush the link for write(), which has [sent] bytes out already and 
+// [earlier] bytes from before it at the front of the buffer - returns false
+// (with [sent] updated) if only part of the buffer went
+bool ESP8266ClientWriteBuffer::flushAll(uint8_t linkID, size_t earlier, size_t & sent)
+{
+	size_t size = sendBufferSize[linkID];
+	int16_t rsp = flush(linkID);
+	if ((rsp >= 0) && ((size_t)rsp >= size))
+	{
+		return true;
+	}
+
+	if ((rsp > 0) && ((size_t)rsp > earlier))
+	{
+		sent += rsp - earlier;
+	}
+	return false;
+}
+
+int16_t ESP8266ClientWriteBuffer::flush(uint8_t linkID)
+{
+	if (linkID >= ESP8266_MAX_SOCK_NUM)
+	{
+		return ESP8266_CMD_BAD;
+	}
+
+	waitForLink(linkID);
+
+	// a background send failed, so the link is no good
+	int16_t error = takeError(linkID);
+	if (error < 0)
+	{
+		sendBufferSize[linkID] = 0;
+		return error;
+	}
+
+	if (sendBufferSize[linkID] == 0)
+	{
+		return 0;
+	}
+
+	// stop poll() starting a background send while we are waiting on this one
+	flushing = true;
+	int16_t rsp = esp8266.tcpSend(linkID, sendBuffer[linkID], sendBufferSize[linkID]);
+	flushing = false;
+
+	// the data has either gone or (if the send failed) the link is no good
+	sendBufferSize[linkID] = 0;
+
+	return rsp;
+}
+
+size_t ESP8266ClientWriteBuffer::pending(uint8_t linkID)
+{
+	return (linkID < ESP8266_MAX_SOCK_NUM) ? sendBufferSize[linkID] : 0;
+}
+
+int16_t ESP8266ClientWriteBuffer::error(uint8_t linkID)
+{
+	return (linkID < ESP8266_MAX_SOCK_NUM) ? sendError[linkID] : 0;
+}
+
+int16_t ESP8266ClientWriteBuffer::takeError(uint8_t linkID)
+{
+	int16_t error = this->error(linkID);
+	if (linkID < ESP8266_MAX_SOCK_NUM)
+	{
+		sendError[linkID] = 0;
+	}
+	return error;
+}
+
+void ESP8266ClientWriteBuffer::clear(uint8_t linkID)
+{
+	if (linkID < ESP8266_MAX_SOCK_NUM)
+	{
+		waitForLink(linkID);
+		sendBufferSize[linkID] = 0;
+		sendError[linkID] = 0;
+	}
+}
+
+void ESP8266ClientWriteBuffer::setDelay(uint8_t linkID, uint16_t ms)
+{
+	if (linkID < ESP8266_MAX_SOCK_NUM)
+	{
+		sendDelay[linkID] = ms;
+	}
+}
+
+void ESP8266ClientWriteBuffer::poll()
+{
+	// one background send at a time
+	if (flushing || (sendingLink != ESP8266_SOCK_NOT_AVAIL) || esp8266.busy())
+	{
+		return;
+	}
+
+	unsigned long now = millis();
+	for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+	{
+		if ((sendBufferSize[i] > 0) && (now - lastWrite[i] >= sendDelay[i]))
+		{
+			// the buffer stays put until sendComplete() is called
+			sendingLink = i;
+			int16_t handle = esp8266.whenDone(esp8266.tcpSendAsync(i, sendBuffer[i], sendBufferSize[i]),
+											  sendComplete, this);
+			if (handle < 0)
+			{
+				sendingLink = ESP8266_SOCK_NOT_AVAIL;
+				sendBufferSize[i] = 0;
+				sendError[i] = handle;
+			}
+			return;
+		}
+	}
+}
+
+void ESP8266ClientWriteBuffer::waitForLink(uint8_t linkID)
+{
+	while (sendingLink == linkID)
+	{
+		esp8266.poll();
+	}
+}
+
+void ESP8266ClientWriteBuffer::sendComplete(void * context, int16_t result)
+{
+	// background send finished - free the buffer, and if it didn't all go
+	// keep the error for the next write() or flush() on the link
+	ESP8266ClientWriteBuffer & buffer = *(ESP8266ClientWriteBuffer *)context;
+	uint8_t link = buffer.sendingLink;
+	if (link < ESP8266_MAX_SOCK_NUM)
+	{
+		if (result < 0)
+		{
+			buffer.sendError[link] = result;
+		}
+		else if ((size_t)result < buffer.sendBufferSize[link])
+		{
+			buffer.sendError[link] = ESP8266_RSP_FAIL;
+		}
+		buffer.sendBufferSize[link] = 0;
+	}
+	buffer.sendingLink = ESP8266_SOCK_NOT_AVAIL;
+}
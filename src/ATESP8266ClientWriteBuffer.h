@@ -0,0 +1,96 @@
+/**
+ATESP8266ClientWriteBuffer.h
+
+Arduino library for managing wifi connections using an ESP8266 in AT mode
+(using AT firmware v1.3.0).
+
+Every AT+CIPSEND is a full round trip to the ESP8266 (~20 ms), so sending
+each byte of a client.print() on its own gives us hundreds of 1 byte TCP
+segments. Instead we collect the writes for each link here and send them
+together when:
+
+- the buffer is full,
+- the client calls flush() (or stop()), or
+- nothing has been written to the link for a little while (like Nagle)
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#ifndef _ATESP8266CLIENTWRITEBUFFER_H_
+#define _ATESP8266CLIENTWRITEBUFFER_H_
+
+#include <Arduino.h>
+
+// bytes of transmit data collected for each link before it has to be sent
+// (AT+CIPSEND can't take more than 2048 bytes at once)
+#ifndef ESP8266_CLIENT_TX_BUFFER_SIZE
+#if defined(__AVR__)
+#define ESP8266_CLIENT_TX_BUFFER_SIZE 32
+#else
+#define ESP8266_CLIENT_TX_BUFFER_SIZE 512
+#endif
+#endif
+
+// how long (in ms) a link can sit idle with unsent data before poll() sends
+// it anyway
+#ifndef ESP8266_CLIENT_TX_DELAY
+#define ESP8266_CLIENT_TX_DELAY 20
+#endif
+
+class ESP8266ClientWriteBuffer {
+
+public:
+	ESP8266ClientWriteBuffer();
+
+	/// write([linkID], [buf], [size]) - Add data to the link's buffer,
+	/// sending it if the buffer fills up
+	/// Returns the number of bytes accepted (0 if an earlier send on the
+	/// link failed - see error())
+	size_t write(uint8_t linkID, const uint8_t *buf, size_t size);
+
+	/// flush([linkID]) - Send whatever is waiting for the link now
+	/// Success: Returns the number of bytes sent (less than pending() if
+	/// the link failed part way through)
+	/// Fail: <0 (esp8266_cmd_rsp), including the error from a background
+	/// send that failed since the last write() or flush()
+	int16_t flush(uint8_t linkID);
+
+	/// error([linkID]) - The result of the last background send on the link
+	/// if it didn't get everything out (0 if it did), and takeError() to
+	/// clear it as well
+	int16_t error(uint8_t linkID);
+	int16_t takeError(uint8_t linkID);
+
+	/// pending([linkID]) - Number of bytes waiting to be sent for the link
+	size_t pending(uint8_t linkID);
+
+	/// clear([linkID]) - Throw away anything waiting for the link
+	void clear(uint8_t linkID);
+
+	/// setDelay([linkID], [ms]) - Idle time before waiting data is sent
+	/// (0 sends everything as soon as it is written)
+	void setDelay(uint8_t linkID, uint16_t ms);
+
+	/// poll() - Start sending any link that has been idle for long enough
+	/// (called by esp8266.poll() when no command is in progress)
+	void poll();
+
+protected:
+	uint8_t sendBuffer[ESP8266_MAX_SOCK_NUM][ESP8266_CLIENT_TX_BUFFER_SIZE];
+	uint16_t sendBufferSize[ESP8266_MAX_SOCK_NUM];
+	uint16_t sendDelay[ESP8266_MAX_SOCK_NUM];
+	unsigned long lastWrite[ESP8266_MAX_SOCK_NUM];
+	int16_t sendError[ESP8266_MAX_SOCK_NUM];
+
+	// the link being sent in the background (if any), and whether we are in
+	// the middle of a blocking flush
+	uint8_t sendingLink;
+	bool flushing;
+
+	bool flushAll(uint8_t linkID, size_t earlier, size_t & sent);
+	void waitForLink(uint8_t linkID);
+	static void sendComplete(void * context, int16_t result);
+};
+
+#endif
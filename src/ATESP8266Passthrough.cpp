@@ -0,0 +1,75 @@
+/**
+ATESP8266Passthrough.cpp
+
+Arduino library for managing wifi connections using an ESP8266 in AT mode
+(using AT firmware v1.3.0).
+
+Streams raw data to a single server using passthrough mode. See 
+ATESP8266Passthrough.h for details.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "ATESP8266WiFi.h"
+#include "ATESP8266Passthrough.h"
+
+ESP8266Passthrough::ESP8266Passthrough()
+{
+}
+
+int16_t ESP8266Passthrough::begin(const char * host, uint16_t port, uint16_t keepAlive)
+{
+	return esp8266.startPassthrough(host, port, keepAlive);
+}
+
+int16_t ESP8266Passthrough::begin(IPAddress ip, uint16_t port, uint16_t keepAlive)
+{
+	char ipAddress[16];
+	sprintf(ipAddress, "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
+	return begin(ipAddress, port, keepAlive);
+}
+
+int16_t ESP8266Passthrough::end()
+{
+	return esp8266.stopPassthrough();
+}
+
+bool ESP8266Passthrough::active()
+{
+	return esp8266.passthrough();
+}
+
+// while the session is active the uart is just a pipe to the server
+size_t ESP8266Passthrough::write(uint8_t c)
+{
+	return active() ? esp8266.serialWrite(&c, 1) : 0;
+}
+
+size_t ESP8266Passthrough::write(const uint8_t *buf, size_t size)
+{
+	return active() ? esp8266.serialWrite(buf, size) : 0;
+}
+
+int ESP8266Passthrough::available()
+{
+	return active() ? esp8266._serial->available() : 0;
+}
+
+int ESP8266Passthrough::read()
+{
+	return active() ? esp8266.serialRead() : -1;
+}
+
+int ESP8266Passthrough::peek()
+{
+	return active() ? esp8266._serial->peek() : -1;
+}
+
+void ESP8266Passthrough::flush()
+{
+	if (active())
+	{
+		esp8266._serial->flush();
+	}
+}
@@ -0,0 +1,62 @@
+/**
+ATESP8266Passthrough.h
+
+Arduino library for managing wifi connections using an ESP8266 in AT mode
+(using AT firmware v1.3.0).
+
+In passthrough (unvarnished transmission) mode the ESP8266 has one TCP
+connection and everything we write to the uart goes straight to the server
+(and everything the server sends comes straight back) - there is no +IPD
+framing and no AT+CIPSEND / SEND OK for each packet. This is the quickest way
+to stream to a single server, but no other AT commands (or links) can be used
+until the session has ended:
+
+ESP8266Passthrough stream;
+stream.begin("example.com", 80);
+stream.print("...");
+stream.end();
+
+Note: the module won't tell us if the server closes the connection (it just
+tries to reconnect), so it is up to the protocol on top to notice.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#ifndef _ATESP8266PASSTHROUGH_H_
+#define _ATESP8266PASSTHROUGH_H_
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include "ATESP8266WiFi.h"
+
+class ESP8266Passthrough : public Stream {
+
+public:
+	ESP8266Passthrough();
+
+	/// begin([host], [port], [keepAlive]) - Connect to the server and start
+	/// streaming (any other links need to be closed first)
+	/// Success: Returns ESP8266_RSP_SUCCESS
+	/// Fail: <0 (esp8266_cmd_rsp)
+	int16_t begin(const char * host, uint16_t port, uint16_t keepAlive = 0);
+	int16_t begin(IPAddress ip, uint16_t port, uint16_t keepAlive = 0);
+
+	/// end() - Stop streaming and close the connection (this takes twice
+	/// ESP8266_PASSTHROUGH_GUARD)
+	int16_t end();
+
+	/// active() - True while the session has the uart
+	bool active();
+
+	size_t write(uint8_t);
+	size_t write(const uint8_t *buf, size_t size);
+	int available();
+	int read();
+	int peek();
+	void flush();
+
+	using Print::write;
+};
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ATESP8266ResponseMatcher.cpp
+
+Arduino library for managing wifi connections using an ESP8266 in AT mode
+(using AT firmware v1.3.0).
+
+Incremental matcher for the responses we wait for after sending an AT
+command. See ATESP8266ResponseMatcher.h for details.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "ATESP8266ResponseMatcher.h"
+
+ESP8266ResponseMatcher::ESP8266ResponseMatcher()
+{
+	reset();
+}
+
+void ESP8266ResponseMatcher::reset()
+{
+	_count = 0;
+	_dropped = false;
+}
+
+int8_t ESP8266ResponseMatcher::add(const char * pattern)
+{
+	// check we have room for another pattern
+	if (_count >= ESP8266_MATCHER_MAX_PATTERNS)
+	{
+		_dropped = true;
+		return ESP8266_MATCHER_NO_MATCH;
+	}
+
+	size_t len = strlen(pattern);
+	if ((len == 0) || (len > ESP8266_MATCHER_MAX_LEN))
+	{
+		_dropped = true;
+		return ESP8266_MATCHER_NO_MATCH;
+	}
+
+	// build the kmp failure table - _failure[i] is the length of the longest
+	// proper prefix of pattern[0..i] that is also a suffix of it
+	uint8_t * failure = _failure[_count];
+	failure[0] = 0;
+	uint8_t k = 0;
+	for (uint8_t i = 1; i < len; i++)
+	{
+		while ((k > 0) && (pattern[i] != pattern[k]))
+		{
+			k = failure[k - 1];
+		}
+		if (pattern[i] == pattern[k])
+		{
+			k++;
+		}
+		failure[i] = k;
+	}
+
+	_pattern[_count] = pattern;
+	_length[_count] = len;
+	_state[_count] = 0;
+
+	return _count++;
+}
+
+bool ESP8266ResponseMatcher::dropped()
+{
+	return _dropped;
+}
+
+void ESP8266ResponseMatcher::restart()
+{
+	for (uint8_t i = 0; i < _count; i++)
+	{
+		_state[i] = 0;
+	}
+}
+
+int8_t ESP8266ResponseMatcher::feed(char c)
+{
+	int8_t matched = ESP8266_MATCHER_NO_MATCH;
+
+	// advance every automaton (the while loop is amortised O(1) per byte)
+	for (uint8_t i = 0; i < _count; i++)
+	{
+		const char * pattern = _pattern[i];
+		uint8_t state = _state[i];
+
+		while ((state > 0) && (c != pattern[state]))
+		{
+			state = _failure[i][state - 1];
+		}
+		if (c == pattern[state])
+		{
+			state++;
+		}
+
+		// full match - report the first pattern that completed and fall back
+		// so overlapping matches can still be found
+		if (state == _length[i])
+		{
+			if (matched == ESP8266_MATCHER_NO_MATCH)
+			{
+				matched = i;
+			}
+			state = _failure[i][state - 1];
+		}
+		_state[i] = state;
+	}
+
+	return matched;
+}
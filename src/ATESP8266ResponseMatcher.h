@@ -0,0 +1,64 @@
+/**
+ATESP8266ResponseMatcher.h
+
+Arduino library for managing wifi connections using an ESP8266 in AT mode
+(using AT firmware v1.3.0).
+
+Incremental matcher for the responses we wait for after sending an AT
+command (OK, ERROR, FAIL, SEND OK, etc.). Rather than re-running strstr over
+the whole receive buffer every time a byte arrives, each pattern gets a small
+KMP automaton that is built once per command and then advanced by one state
+per received byte. All the patterns are advanced together, so checking for
+pass and fail responses at the same time costs the same as checking for one.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#ifndef _ATESP8266RESPONSEMATCHER_H_
+#define _ATESP8266RESPONSEMATCHER_H_
+
+#include <Arduino.h>
+
+// maximum number of responses we can look for at once, and the maximum length
+// of each response string
+#define ESP8266_MATCHER_MAX_PATTERNS    4
+#define ESP8266_MATCHER_MAX_LEN         16
+
+#define ESP8266_MATCHER_NO_MATCH        -1
+
+class ESP8266ResponseMatcher {
+
+public:
+	ESP8266ResponseMatcher();
+
+	/// reset() - Remove all the patterns from the matcher
+	void reset();
+
+	/// add([pattern]) - Build the automaton for [pattern]
+	/// Success: Returns the index of the pattern
+	/// Fail: Returns ESP8266_MATCHER_NO_MATCH (too many / too long)
+	int8_t add(const char * pattern);
+
+	/// dropped() - True if add() has turned a pattern away since the last
+	/// reset() (so a response could arrive without being spotted)
+	bool dropped();
+
+	/// restart() - Rewind all the automata, keeping the patterns
+	void restart();
+
+	/// feed([c]) - Advance every automaton by one byte
+	/// Match: Returns the index of the pattern completed by [c]
+	/// No match: Returns ESP8266_MATCHER_NO_MATCH
+	int8_t feed(char c);
+
+private:
+	const char * _pattern[ESP8266_MATCHER_MAX_PATTERNS];
+	uint8_t _length[ESP8266_MATCHER_MAX_PATTERNS];
+	uint8_t _state[ESP8266_MATCHER_MAX_PATTERNS];
+	uint8_t _failure[ESP8266_MATCHER_MAX_PATTERNS][ESP8266_MATCHER_MAX_LEN];
+	uint8_t _count;
+	bool _dropped;
+};
+
+#endif
@@ -26,6 +26,7 @@ Distributed as-is; no warranty is given.
 ESP8266Server::ESP8266Server(uint16_t port)
 {
     _port = port;
+    _lastLink = ESP8266_MAX_SOCK_NUM - 1;
 }
 
 void ESP8266Server::begin()
@@ -33,28 +34,41 @@ void ESP8266Server::begin()
 	esp8266.configureTCPServer(_port, 1);
 }
 
+ESP8266Client ESP8266Server::accept()
+{
+	// new connections are queued by the esp8266 event dispatcher as their
+	// CONNECT arrives (even in the middle of another command)
+	esp8266.poll();
+	return ESP8266Client(esp8266.takeConnectEvent());
+}
+
 ESP8266Client ESP8266Server::available(uint8_t wait)
 {
-	if (esp8266.readForResponse(",CONNECT", wait) > 0)
+	// new connections come first - we only need to wait for one to be queued
+	unsigned long timeIn = millis();
+	do
 	{
-		char * p = esp8266.searchBuffer(",CONNECT");
-		p -= 1;
-		//p -= 1; // Move p back one character
-		uint8_t sock = *p - 48;
-		ESP8266Client client(sock);
-		return client;
-	}
-	if (esp8266.updateStatus())
+		ESP8266Client client = accept();
+		if (client)
+		{
+			return client;
+		}
+	} while (millis() - timeIn < wait);
+
+	// otherwise hand back a link that is already connected to us and has 
+	// something to read - starting after the last one, so every client gets
+	// a turn (the socket table is kept up to date by the link events)
+	for (int i = 1; i <= ESP8266_MAX_SOCK_NUM; i++)
 	{
-		for (int sock=0; sock<ESP8266_MAX_SOCK_NUM; sock++)
+		uint8_t sock = (_lastLink + i) % ESP8266_MAX_SOCK_NUM;
+		if ((esp8266._status.ipstatus[sock].linkID != 255) &&
+		      (esp8266._status.ipstatus[sock].tetype == ESP8266_SERVER) &&
+		      (esp8266._receiveBuffer.available(sock) > 0))
 		{
-			if ((esp8266._status.ipstatus[sock].linkID != 255) &&
-			      (esp8266._status.ipstatus[sock].tetype == ESP8266_SERVER))
-			{
-				ESP8266Client client(sock);
-				
-				return client;
-			}
+			_lastLink = sock;
+			ESP8266Client client(sock);
+			
+			return client;
 		}
 	}
 	
@@ -74,22 +88,47 @@ size_t ESP8266Server::write(uint8_t b)
 
 size_t ESP8266Server::write(const uint8_t *buffer, size_t size)
 {	
+	// pick up any links that have closed before we start
+	esp8266.poll();
 
 	size_t n = 0;
-/*
-    for (int sock = 0; sock < MAX_SOCK_NUM; sock++)
-    {
-        if (WiFiClass::_server_port[sock] != 0)
-        {
-        	ESP8266Client client(sock);
-
-            if (WiFiClass::_server_port[sock] == _port &&
-                client.status() == ESTABLISHED)
-            {                
-                return esp8266.tcpSend(sock, buf, size);
-            }
-        }
-    }
-*/
-    return n;
+	for (int sock = 0; sock < ESP8266_MAX_SOCK_NUM; sock++)
+	{
+		if ((esp8266._status.ipstatus[sock].linkID != 255) &&
+		      (esp8266._status.ipstatus[sock].tetype == ESP8266_SERVER))
+		{
+			// same data for every link, collected with whatever else the
+			// link's client has written (so it is all sent in order), and 
+			// flushed straight away so we know whether it got there
+			bool sent = (esp8266._sendBuffer.write(sock, buffer, size) == size);
+			if (sent)
+			{
+				// ours is at the end of whatever is still waiting, so it
+				// has only all gone if everything has
+				size_t waiting = esp8266._sendBuffer.pending(sock);
+				int16_t rsp = esp8266._sendBuffer.flush(sock);
+				sent = (rsp >= 0) && ((size_t)rsp >= waiting);
+			}
+
+			// (the same bytes went to every link, so they are only
+			// counted once)
+			if (sent)
+			{
+				n = size;
+			}
+
+			// if the send failed the link is no good - get rid of it
+			// (if the module won't close it, it has already gone)
+			if (!sent)
+			{
+				esp8266._sendBuffer.clear(sock);
+				if (esp8266.close(sock) <= 0)
+				{
+					esp8266.closeLink(sock);
+				}
+			}
+		}
+	}
+
+	return n;
 }
@@ -33,7 +33,15 @@ class ESP8266Server : public Server
 public:
 	ESP8266Server(uint16_t);
 	ESP8266Client available(uint8_t wait = 0);
+
+	/// accept() - The oldest new connection that hasn't been accepted yet
+	/// (doesn't wait - the client is not connected if there isn't one)
+	ESP8266Client accept();
 	void begin();
+	/// write([buf], [size]) - Send the data to every client connected to
+	/// the server now (any link a send fails on is closed)
+	/// Returns [size] if at least one link took all of it, or 0 if none did
+	/// (so print() counts what was written once, not once per link)
 	virtual size_t write(uint8_t);
 	virtual size_t write(const uint8_t *buf, size_t size);
 	uint8_t status();
@@ -42,6 +50,9 @@ public:
 	
 private:
 	uint16_t _port;
+
+	// the last link available() handed back, so the others get a turn
+	uint8_t _lastLink;
 };
 
 #endif
@@ -0,0 +1,403 @@
+/**
+ATESP8266Trace.cpp
+
+Arduino library for managing wifi connections using an ESP8266 in AT mode
+(using AT firmware v1.3.0).
+
+Records the uart traffic and plays it back. See ATESP8266Trace.h for details.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "ATESP8266WiFi.h"
+#include "ATESP8266Trace.h"
+#include "util/ESP8266_AT.h"
+
+//////////////////
+// ESP8266Trace //
+//////////////////
+
+ESP8266Trace::ESP8266Trace()
+{
+	_enabled = true;
+	clear();
+}
+
+void ESP8266Trace::record(uint8_t type, const uint8_t * data, size_t size)
+{
+	if (!_enabled || (size == 0))
+	{
+		return;
+	}
+
+	// the first byte carries the time since the last record, and the rest
+	// went at the same time
+	unsigned long now = micros();
+	unsigned long delta = now - _last;
+	_last = now;
+
+	// long gaps are counted in milliseconds
+	while (delta > 0xFFFF)
+	{
+		unsigned long ms = delta / 1000;
+		if (ms > 0xFFFF)
+		{
+			ms = 0xFFFF;
+		}
+		push(ms, ESP8266_TRACE_GAP, 0);
+		delta -= ms * 1000;
+	}
+
+	push(delta, type, data[0]);
+	for (size_t i = 1; i < size; i++)
+	{
+		push(0, type, data[i]);
+	}
+}
+
+void ESP8266Trace::record(uint8_t type, uint8_t c)
+{
+	record(type, &c, 1);
+}
+
+void ESP8266Trace::enable(bool on)
+{
+	_enabled = on;
+}
+
+size_t ESP8266Trace::available()
+{
+	return _count;
+}
+
+unsigned long ESP8266Trace::lost()
+{
+	return _lost;
+}
+
+size_t ESP8266Trace::read(esp8266_trace_record * records, size_t max)
+{
+	size_t count = (max < _count) ? max : _count;
+	uint16_t tail = (_head + ESP8266_TRACE_LEN - _count) % ESP8266_TRACE_LEN;
+	for (size_t i = 0; i < count; i++)
+	{
+		records[i] = _ring[(tail + i) % ESP8266_TRACE_LEN];
+	}
+	return count;
+}
+
+size_t ESP8266Trace::dump(Print & out)
+{
+	uint8_t header[8] = { 'E', 'S', 'P', 'T', ESP8266_TRACE_VERSION, 0,
+						  (uint8_t)(_count & 0xFF), (uint8_t)(_count >> 8) };
+	size_t written = out.write(header, sizeof(header));
+
+	uint16_t tail = (_head + ESP8266_TRACE_LEN - _count) % ESP8266_TRACE_LEN;
+	for (uint16_t i = 0; i < _count; i++)
+	{
+		const esp8266_trace_record & r = _ring[(tail + i) % ESP8266_TRACE_LEN];
+		uint8_t bytes[4] = { (uint8_t)(r.delta & 0xFF), (uint8_t)(r.delta >> 8), r.type, r.c };
+		written += out.write(bytes, sizeof(bytes));
+	}
+	return written;
+}
+
+void ESP8266Trace::clear()
+{
+	_head = 0;
+	_count = 0;
+	_lost = 0;
+	_last = micros();
+}
+
+void ESP8266Trace::push(uint16_t delta, uint8_t type, uint8_t c)
+{
+	esp8266_trace_record & r = _ring[_head];
+	r.delta = delta;
+	r.type = type;
+	r.c = c;
+
+	_head = (_head + 1) % ESP8266_TRACE_LEN;
+	if (_count < ESP8266_TRACE_LEN)
+	{
+		_count++;
+	}
+	else
+	{
+		_lost++;
+	}
+}
+
+////////////////////////
+// ESP8266TraceReplay //
+////////////////////////
+
+// how much data follows an AT+CIPSEND=... line (the library always sends
+// with several links on, so the length is the second field) - it isn't a
+// line of its own, so it mustn't be mistaken for the start of the next one
+static unsigned long sendLength(const char * line)
+{
+	if ((strncmp(line + 2, ESP8266_TCP_SEND, strlen(ESP8266_TCP_SEND)) != 0) ||
+		(strchr(line, '=') == NULL))
+	{
+		return 0;
+	}
+	const char * comma = strchr(line, ',');
+	return (comma == NULL) ? 0 : strtoul(comma + 1, NULL, 10);
+}
+
+ESP8266TraceReplay::ESP8266TraceReplay()
+{
+	begin(NULL, 0);
+}
+
+void ESP8266TraceReplay::begin(const esp8266_trace_record * records, size_t count, uint8_t speed)
+{
+	_records = records;
+	_count = count;
+	_speed = speed;
+
+	_rxNext = 0;
+	_rxReady = 0;
+	_commands = 0;
+	_passed = 0;
+	_failed = 0;
+	_timedOut = 0;
+	_received = 0;
+	_payload = 0;
+	_recorded = 0;
+	_elapsed = 0;
+}
+
+void ESP8266TraceReplay::run()
+{
+	// stand in for the module
+	Stream * serial = esp8266._serial;
+	esp8266._serial = this;
+	esp8266.clearBuffer();
+
+	unsigned long start = micros();
+	unsigned long at = 0;
+	char line[24];
+	uint8_t lineLen = 0;
+	unsigned long sendData = 0;
+
+	for (size_t i = 0; i < _count; i++)
+	{
+		const esp8266_trace_record & r = _records[i];
+
+		// (the first record's delta is from something that isn't in the
+		// trace any more)
+		if (i > 0)
+		{
+			at += (r.type == ESP8266_TRACE_GAP) ? (unsigned long)r.delta * 1000 : r.delta;
+		}
+
+		// wait for the time it happened, with the parser running - or if
+		// we aren't waiting, at least let it see everything that came
+		// before the next command
+		if (_speed > 0)
+		{
+			while ((micros() - start) * _speed < at)
+			{
+				pump();
+			}
+		}
+		else if ((r.type == ESP8266_TRACE_TX) && (lineLen == 0) && (sendData == 0))
+		{
+			drain();
+		}
+
+		if (r.type == ESP8266_TRACE_RX)
+		{
+			_rxReady++;
+		}
+		else if ((r.type == ESP8266_TRACE_TX) && (sendData > 0))
+		{
+			sendData--;
+		}
+		else if (r.type == ESP8266_TRACE_TX)
+		{
+			// every AT command gets a response, so wait for one
+			if (lineLen < sizeof(line) - 1)
+			{
+				line[lineLen] = r.c;
+			}
+			lineLen++;
+			if (r.c == '\n')
+			{
+				line[min(lineLen, (uint8_t)(sizeof(line) - 1))] = '\0';
+				if ((lineLen > 2) && (line[0] == 'A') && (line[1] == 'T'))
+				{
+					startCommand();
+					sendData = sendLength(line);
+				}
+				lineLen = 0;
+			}
+		}
+		pump();
+	}
+
+	// let the last command finish
+	drain();
+	while (esp8266.busy())
+	{
+		pump();
+	}
+	finishCommand();
+
+	_recorded = at;
+	_elapsed = micros() - start;
+	esp8266._serial = serial;
+}
+
+uint16_t ESP8266TraceReplay::commands()
+{
+	return _commands;
+}
+
+uint16_t ESP8266TraceReplay::passed()
+{
+	return _passed;
+}
+
+uint16_t ESP8266TraceReplay::failed()
+{
+	return _failed;
+}
+
+uint16_t ESP8266TraceReplay::timedOut()
+{
+	return _timedOut;
+}
+
+unsigned long ESP8266TraceReplay::received()
+{
+	return _received;
+}
+
+unsigned long ESP8266TraceReplay::payload()
+{
+	return _payload;
+}
+
+unsigned long ESP8266TraceReplay::recorded()
+{
+	return _recorded;
+}
+
+unsigned long ESP8266TraceReplay::elapsed()
+{
+	return _elapsed;
+}
+
+// the received bytes are handed over as they "arrive"
+int ESP8266TraceReplay::available()
+{
+	return _rxReady;
+}
+
+int ESP8266TraceReplay::read()
+{
+	int c = peek();
+	if (c >= 0)
+	{
+		_rxNext++;
+		_rxReady--;
+		_received++;
+	}
+	return c;
+}
+
+int ESP8266TraceReplay::peek()
+{
+	if (_rxReady == 0)
+	{
+		return -1;
+	}
+	while (_records[_rxNext].type != ESP8266_TRACE_RX)
+	{
+		_rxNext++;
+	}
+	return _records[_rxNext].c;
+}
+
+void ESP8266TraceReplay::flush()
+{
+}
+
+// anything sent now is already in the trace
+size_t ESP8266TraceReplay::write(uint8_t c)
+{
+	(void)c;
+	return 1;
+}
+
+// arm the command engine the way readForResponses() would
+void ESP8266TraceReplay::startCommand()
+{
+	// if the last one is still going it never got an answer
+	if (esp8266.busy())
+	{
+		esp8266.finishCommand(ESP8266_RSP_TIMEOUT);
+	}
+	finishCommand();
+
+	esp8266._matcher.reset();
+	esp8266._matcher.add(RESPONSE_OK);
+	esp8266._matcher.add(RESPONSE_ERROR);
+	esp8266._matcher.add(RESPONSE_FAIL);
+	esp8266._matcher.add(RESPONSE_BUSY);
+	esp8266.startCommand(CLIENT_CONNECT_TIMEOUT / ((_speed > 0) ? _speed : 1));
+	_commands++;
+}
+
+// count how the last command went
+void ESP8266TraceReplay::finishCommand()
+{
+	if ((_commands == 0) || esp8266.busy() ||
+		(_passed + _failed + _timedOut >= _commands))
+	{
+		return;
+	}
+
+	int16_t result = esp8266._cmd.result;
+	if (result >= 0)
+	{
+		_passed++;
+	}
+	else if (result == ESP8266_RSP_TIMEOUT)
+	{
+		_timedOut++;
+	}
+	else
+	{
+		_failed++;
+	}
+}
+
+// run the parser, and throw away the +IPD payloads (nobody is reading them)
+void ESP8266TraceReplay::pump()
+{
+	esp8266.poll();
+	finishCommand();
+
+	uint8_t buf[32];
+	for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+	{
+		while (esp8266._receiveBuffer.available(i) > 0)
+		{
+			_payload += esp8266._receiveBuffer.read(i, buf, sizeof(buf));
+		}
+	}
+}
+
+// let the parser have everything that has arrived
+void ESP8266TraceReplay::drain()
+{
+	while (_rxReady > 0)
+	{
+		pump();
+	}
+}
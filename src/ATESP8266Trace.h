@@ -0,0 +1,175 @@
+/**
+ATESP8266Trace.h
+
+Arduino library for managing wifi connections using an ESP8266 in AT mode
+(using AT firmware v1.3.0).
+
+A record of the traffic on the uart, for working out what went wrong after
+the event. Build with ESP8266_TRACE defined and every byte esp8266 sends to
+or reads from the module goes into a ring of 4 byte records (the newest
+ESP8266_TRACE_LEN are kept):
+
+	<delta:2> <type:1> <byte:1>
+
+where delta is the time in microseconds since the record before (a gap of
+more than 65ms gets an ESP8266_TRACE_GAP record first, with delta in ms).
+dump() writes the ring out to any Print (e.g. Serial, or a file) as
+
+	"ESPT" <version:1 = 1> <reserved:1> <count:2> <record:4> ...
+
+(little endian), and ESP8266TraceReplay plays a trace back through the
+response parser and the +IPD framing - at the speed it was recorded, faster,
+or as fast as it can go - so a problem from the field can be reproduced and
+profiled on the bench (it leaves esp8266 in whatever state the trace does):
+
+ESP8266TraceReplay replay;
+replay.begin(records, count, 1);
+replay.run();
+
+With ESP8266_TRACE not defined none of this is built into esp8266, so it
+costs nothing.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#ifndef _ATESP8266TRACE_H_
+#define _ATESP8266TRACE_H_
+
+#include <Arduino.h>
+
+// how many records (4 bytes each) the trace keeps
+#ifndef ESP8266_TRACE_LEN
+#if defined(__AVR__)
+#define ESP8266_TRACE_LEN       64
+#else
+#define ESP8266_TRACE_LEN       1024
+#endif
+#endif
+
+#define ESP8266_TRACE_VERSION   1
+
+enum esp8266_trace_type {
+	ESP8266_TRACE_TX = 0,		// a byte we sent to the module
+	ESP8266_TRACE_RX = 1,		// a byte we read from the module
+	ESP8266_TRACE_GAP = 2		// nothing for [delta] milliseconds
+};
+
+struct esp8266_trace_record
+{
+	uint16_t delta;
+	uint8_t type;
+	uint8_t c;
+};
+
+class ESP8266Trace {
+
+public:
+	ESP8266Trace();
+
+	/// record([type], [data], [size]) - Add [size] bytes going the same
+	/// way at the same time
+	void record(uint8_t type, const uint8_t * data, size_t size);
+	void record(uint8_t type, uint8_t c);
+
+	/// enable([on]) - Start or stop recording (it starts on)
+	void enable(bool on);
+
+	/// available() - Number of records in the ring
+	size_t available();
+
+	/// lost() - Number of records pushed out of the ring by newer ones
+	unsigned long lost();
+
+	/// read([records], [max]) - Copy up to [max] records out, oldest first
+	/// (the ring is left as it is)
+	size_t read(esp8266_trace_record * records, size_t max);
+
+	/// dump([out]) - Write the ring to [out] in the binary format above
+	/// Returns the number of bytes written
+	size_t dump(Print & out);
+
+	/// clear() - Empty the ring
+	void clear();
+
+private:
+	void push(uint16_t delta, uint8_t type, uint8_t c);
+
+	esp8266_trace_record _ring[ESP8266_TRACE_LEN];
+	uint16_t _head;
+	uint16_t _count;
+	unsigned long _lost;
+	unsigned long _last;
+	bool _enabled;
+};
+
+class ESP8266TraceReplay : public Stream {
+
+public:
+	ESP8266TraceReplay();
+
+	/// begin([records], [count], [speed]) - Get ready to play [records]
+	/// back - [speed] of 1 is as recorded, 2 is twice as fast and so on, and
+	/// 0 doesn't wait at all
+	void begin(const esp8266_trace_record * records, size_t count, uint8_t speed = 1);
+
+	/// run() - Play the whole trace through esp8266. Every command in the
+	/// trace waits for its response (OK, ERROR, FAIL or busy) the way the
+	/// library would have, and the received bytes are given to the parser
+	/// when they arrived. Only the uart is put back afterwards - the
+	/// CONNECTs, CLOSEDs and +IPD data in the trace change the socket
+	/// table, the accept queue, the receive buffers and the stats just as
+	/// they did the first time, so only replay on an esp8266 that is idle
+	/// and isn't going to be used for anything else (e.g. on the bench).
+	void run();
+
+	/// commands() / passed() / failed() / timedOut() - How the commands
+	/// in the trace went this time round
+	uint16_t commands();
+	uint16_t passed();
+	uint16_t failed();
+	uint16_t timedOut();
+
+	/// received() - Bytes given to the parser, and payload() - how many of
+	/// them were +IPD data
+	unsigned long received();
+	unsigned long payload();
+
+	/// recorded() / elapsed() - How long (in us) the trace took to record,
+	/// and to play back
+	unsigned long recorded();
+	unsigned long elapsed();
+
+	// the module side of the uart
+	int available();
+	int read();
+	int peek();
+	void flush();
+	size_t write(uint8_t c);
+	using Print::write;
+
+private:
+	void startCommand();
+	void finishCommand();
+	void pump();
+	void drain();
+
+	const esp8266_trace_record * _records;
+	size_t _count;
+	uint8_t _speed;
+
+	// the received bytes that have "arrived" but haven't been read
+	size_t _rxNext;
+	size_t _rxReady;
+
+	uint16_t _commands;
+	uint16_t _passed;
+	uint16_t _failed;
+	uint16_t _timedOut;
+	unsigned long _received;
+	unsigned long _payload;
+	unsigned long _recorded;
+	unsigned long _elapsed;
+};
+
+#endif
@@ -0,0 +1,228 @@
+/**
+ATESP8266UDP.cpp
+
+Arduino library for managing wifi connections using an ESP8266 in AT mode
+(using AT firmware v1.3.0).
+
+Sends and receives UDP datagrams. See ATESP8266UDP.h for details.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#include "ATESP8266WiFi.h"
+#include "ATESP8266UDP.h"
+
+ESP8266UDP::ESP8266UDP()
+{
+	_socket = ESP8266_SOCK_NOT_AVAIL;
+	_packetRemaining = 0;
+	_remotePort = 0;
+	_sendSize = 0;
+	_sending = false;
+	_sendOverflow = false;
+}
+
+uint8_t ESP8266UDP::begin(uint16_t port)
+{
+	// pick up any links that have closed, then find a free one
+	esp8266.poll();
+	_socket = ESP8266_SOCK_NOT_AVAIL;
+	for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+	{
+		if (esp8266._state[i] == AVAILABLE)
+		{
+			_socket = i;
+			break;
+		}
+	}
+	if (_socket == ESP8266_SOCK_NOT_AVAIL)
+	{
+		return 0;
+	}
+
+	// we need +IPD to tell us who each datagram is from
+	esp8266._state[_socket] = TAKEN;
+	if ((esp8266.setDataInfo(true) < 0) ||
+		(esp8266.udpConnect(_socket, "0.0.0.0", 0, port, 2) < 0))
+	{
+		esp8266._state[_socket] = AVAILABLE;
+		_socket = ESP8266_SOCK_NOT_AVAIL;
+		return 0;
+	}
+
+	esp8266._receiveBuffer.setDatagram(_socket, true);
+	_packetRemaining = 0;
+	return 1;
+}
+
+void ESP8266UDP::stop()
+{
+	if (_socket == ESP8266_SOCK_NOT_AVAIL)
+	{
+		return;
+	}
+
+	esp8266.close(_socket);
+	esp8266._receiveBuffer.setDatagram(_socket, false);
+	esp8266._state[_socket] = AVAILABLE;
+	_socket = ESP8266_SOCK_NOT_AVAIL;
+	_packetRemaining = 0;
+	_sending = false;
+}
+
+/////////////
+// Sending //
+/////////////
+
+int ESP8266UDP::beginPacket(IPAddress ip, uint16_t port)
+{
+	char ipAddress[16];
+	sprintf(ipAddress, "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
+	return beginPacket(ipAddress, port);
+}
+
+int ESP8266UDP::beginPacket(const char *host, uint16_t port)
+{
+	if ((_socket == ESP8266_SOCK_NOT_AVAIL) || (strlen(host) > ESP8266_UDP_HOST_LEN))
+	{
+		return 0;
+	}
+
+	// AT+CIPSEND wants an ip address, so look the host up (through the 
+	// cache) if we can
+	IPAddress ip;
+	if ((strspn(host, "0123456789.") != strlen(host)) && (esp8266.resolve(host, ip) == ESP8266_RSP_SUCCESS))
+	{
+		return beginPacket(ip, port);
+	}
+
+	strcpy(_sendHost, host);
+	_sendPort = port;
+	_sendSize = 0;
+	_sending = true;
+	_sendOverflow = false;
+	return 1;
+}
+
+size_t ESP8266UDP::write(uint8_t c)
+{
+	return write(&c, 1);
+}
+
+size_t ESP8266UDP::write(const uint8_t *buffer, size_t size)
+{
+	if (!_sending || _sendOverflow)
+	{
+		return 0;
+	}
+
+	// a datagram can't be split, and a cut short one would look just like a
+	// complete (shorter) one - so once it doesn't fit, none of it is sent
+	size_t count = min(size, (size_t)(ESP8266_UDP_TX_BUFFER_SIZE - _sendSize));
+	if (count < size)
+	{
+		_sendOverflow = true;
+		return 0;
+	}
+	memcpy(&_sendBuffer[_sendSize], buffer, count);
+	_sendSize += count;
+	return count;
+}
+
+int ESP8266UDP::endPacket()
+{
+	if (!_sending)
+	{
+		return 0;
+	}
+	_sending = false;
+
+	if ((_sendSize == 0) || _sendOverflow)
+	{
+		return 0;
+	}
+	return (esp8266.udpSend(_socket, _sendBuffer, _sendSize, _sendHost, _sendPort) > 0) ? 1 : 0;
+}
+
+///////////////
+// Receiving //
+///////////////
+
+int ESP8266UDP::parsePacket()
+{
+	if (_socket == ESP8266_SOCK_NOT_AVAIL)
+	{
+		return 0;
+	}
+
+	// skip whatever is left of the last datagram
+	esp8266._receiveBuffer.discard(_socket, _packetRemaining);
+	_packetRemaining = 0;
+
+	esp8266.poll();
+	esp8266_datagram datagram;
+	if (!esp8266._receiveBuffer.takeDatagram(_socket, datagram))
+	{
+		return 0;
+	}
+
+	_packetRemaining = datagram.length;
+	_remoteIP = IPAddress(datagram.remoteIP[0], datagram.remoteIP[1], 
+		datagram.remoteIP[2], datagram.remoteIP[3]);
+	_remotePort = datagram.remotePort;
+	return _packetRemaining;
+}
+
+int ESP8266UDP::available()
+{
+	return _packetRemaining;
+}
+
+int ESP8266UDP::read()
+{
+	if (_packetRemaining == 0)
+	{
+		return -1;
+	}
+
+	_packetRemaining--;
+	return esp8266._receiveBuffer.read(_socket);
+}
+
+int ESP8266UDP::read(unsigned char* buffer, size_t len)
+{
+	// don't run on into the next datagram
+	size_t count = esp8266._receiveBuffer.read(_socket, buffer, min(len, (size_t)_packetRemaining));
+	_packetRemaining -= count;
+	return count;
+}
+
+int ESP8266UDP::read(char* buffer, size_t len)
+{
+	return read((unsigned char *)buffer, len);
+}
+
+int ESP8266UDP::peek()
+{
+	if (_packetRemaining == 0)
+	{
+		return -1;
+	}
+	return esp8266._receiveBuffer.peek(_socket);
+}
+
+void ESP8266UDP::flush()
+{
+	// nothing to do - datagrams are sent by endPacket()
+}
+
+IPAddress ESP8266UDP::remoteIP()
+{
+	return _remoteIP;
+}
+
+uint16_t ESP8266UDP::remotePort()
+{
+	return _remotePort;
+}
@@ -0,0 +1,100 @@
+/**
+ATESP8266UDP.h
+
+Arduino library for managing wifi connections using an ESP8266 in AT mode
+(using AT firmware v1.3.0).
+
+This fits the Arduino Udp.h api. Each ESP8266UDP uses one link, opened with 
+AT+CIPSTART="UDP" in mode 2 so it can take datagrams from anyone and send 
+to anyone. 
+
+Incoming datagrams keep their boundaries - parsePacket() moves on to the 
+next one and remoteIP() / remotePort() say who sent it (from +CIPDINFO). 
+A datagram that doesn't fit in the link's receive buffer (so anything over 
+ESP8266_CLIENT_MAX_BUFFER_SIZE) is dropped whole rather than cut short.
+Anything written between beginPacket() and endPacket() is collected and 
+sent as a single datagram with one AT+CIPSEND - and if it doesn't all fit in
+ESP8266_UDP_TX_BUFFER_SIZE the datagram isn't sent at all, the same as one 
+that is too big to receive.
+
+author: Alex Shenfield
+date:   16/10/2026
+*/
+
+#ifndef _ATESP8266UDP_H_
+#define _ATESP8266UDP_H_
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include "Udp.h"
+#include "ATESP8266WiFi.h"
+
+// largest datagram we can send (collected between beginPacket() and 
+// endPacket())
+#ifndef ESP8266_UDP_TX_BUFFER_SIZE
+#if defined(__AVR__)
+#define ESP8266_UDP_TX_BUFFER_SIZE 64
+#else
+#define ESP8266_UDP_TX_BUFFER_SIZE 512
+#endif
+#endif
+
+// longest host name (or ip address) beginPacket() can send to
+#ifndef ESP8266_UDP_HOST_LEN
+#define ESP8266_UDP_HOST_LEN 32
+#endif
+
+class ESP8266UDP : public UDP {
+
+public:
+	ESP8266UDP();
+
+	/// begin([port]) - Start listening on [port]
+	/// Returns 1 if successful, 0 if there are no links free (or it failed)
+	virtual uint8_t begin(uint16_t port);
+	virtual void stop();
+
+	/// beginPacket([ip], [port]) - Start collecting a datagram to send
+	virtual int beginPacket(IPAddress ip, uint16_t port);
+	virtual int beginPacket(const char *host, uint16_t port);
+
+	/// endPacket() - Send the datagram. Returns 1 if it was sent, 0 if not
+	/// (or if more was written than the datagram can hold).
+	virtual int endPacket();
+	virtual size_t write(uint8_t);
+	virtual size_t write(const uint8_t *buffer, size_t size);
+
+	/// parsePacket() - Move on to the next datagram that has arrived
+	/// Returns its size, or 0 if there isn't one
+	virtual int parsePacket();
+	virtual int available();
+	virtual int read();
+	virtual int read(unsigned char* buffer, size_t len);
+	virtual int read(char* buffer, size_t len);
+	virtual int peek();
+	virtual void flush();
+
+	/// remoteIP() / remotePort() - Who sent the current datagram
+	virtual IPAddress remoteIP();
+	virtual uint16_t remotePort();
+
+	using Print::write;
+
+private:
+	uint8_t _socket;
+
+	// the datagram being read
+	uint16_t _packetRemaining;
+	IPAddress _remoteIP;
+	uint16_t _remotePort;
+
+	// the datagram being written
+	char _sendHost[ESP8266_UDP_HOST_LEN + 1];
+	uint16_t _sendPort;
+	uint8_t _sendBuffer[ESP8266_UDP_TX_BUFFER_SIZE];
+	uint16_t _sendSize;
+	bool _sending;
+	bool _sendOverflow;
+};
+
+#endif
@@ -21,6 +21,7 @@ date:   11/09/2020
 */
 
 #include <Arduino.h>
+#include <stdarg.h>
 
 #include "util/ESP8266_AT.h"
 #include "ATESP8266WiFi.h"
@@ -32,12 +33,44 @@ date:   11/09/2020
 // Buffer Definitions //
 ////////////////////////
 
-// set the buffer length
-#define ESP8266_RX_BUFFER_LEN 128
-
-// define the rx buffer
-char esp8266RxBuffer[ESP8266_RX_BUFFER_LEN];
+// define the rx buffer - this is a ring of ESP8266_RX_BUFFER_LEN bytes (plus
+// one for the terminating null when we linearise it for parsing)
+char esp8266RxBuffer[ESP8266_RX_BUFFER_LEN + 1];
 unsigned int bufferHead;
+unsigned int bufferCount;
+unsigned long bufferOverflow;
+
+// define the staging buffer commands are formatted into before sending
+char esp8266TxBuffer[ESP8266_TX_BUFFER_LEN];
+
+// fnv-1a and djb2 hashes, and the length, of a host name
+static esp8266_host_key hostKey(const char * host)
+{
+    esp8266_host_key key;
+    key.fnv = 2166136261UL;
+    key.djb = 5381;
+    size_t length = 0;
+    while (*host)
+    {
+        uint8_t c = *host++;
+        key.fnv = (key.fnv ^ c) * 16777619UL;
+        key.djb = ((key.djb << 5) + key.djb) ^ c;
+        length++;
+    }
+    key.length = (length > 0xFF) ? 0xFF : length;
+    return key;
+}
+
+static bool sameHost(const esp8266_host_key & a, const esp8266_host_key & b)
+{
+    return (a.fnv == b.fnv) && (a.djb == b.djb) && (a.length == b.length);
+}
+
+// true if the host is already an ip address (so there is nothing to look up)
+static bool isAddress(const char * host)
+{
+    return strspn(host, "0123456789.") == strlen(host);
+}
 
 ////////////////////
 // Initialization //
@@ -49,7 +82,59 @@ ESP8266Class::ESP8266Class()
     for (int i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
     {
         _state[i] = AVAILABLE;
+        _status.ipstatus[i].linkID = ESP8266_SOCK_NOT_AVAIL;
+        _pool[i].keyed = false;
+        _pool[i].idle = false;
+        _window[i].mode = ESP8266_SEND_DIRECT;
+        resetWindow(i);
+    }
+
+    // nothing in progress yet
+    _cmd.state = ESP8266_CMD_IDLE;
+    _cmd.handle = 0;
+    _cmd.result = ESP8266_RSP_UNKNOWN;
+    _cmd.payload = NULL;
+    _cmd.payloadLen = 0;
+    _cmd.remote = NULL;
+    _cmd.line = NULL;
+    _cmd.done = NULL;
+    _cmd.context = NULL;
+    for (int i = 0; i < ESP8266_CMD_RESULTS; i++)
+    {
+        _results[i].handle = 0;
+        _results[i].result = ESP8266_RSP_UNKNOWN;
     }
+    _resultNext = 0;
+    _statusListed = 0;
+    _statusHeader = false;
+    _statusOverflow = 0;
+
+    // no unsolicited result codes seen yet
+    _urc.state = ESP8266_URC_LINE;
+    _urc.lineLen = 0;
+    _urc.acceptHead = 0;
+    _urc.acceptCount = 0;
+    _urc.connected = 0;
+    _urc.closed = 0;
+    _urc.opening = 0;
+    _urc.handler = NULL;
+
+    _passthrough = false;
+    _status.stat = ESP8266_STATUS_NOWIFI;
+
+    _poolSize = ESP8266_POOL_SIZE;
+    _poolTimeout = ESP8266_POOL_TIMEOUT;
+
+    flushDnsCache();
+    _dnsTTL = ESP8266_DNS_TTL;
+
+    _batch.targets = NULL;
+
+#ifdef ESP8266_STATS
+    _statsCommand = ESP8266_STATS_OTHER;
+    clearStats();
+    memset(_linkStats, 0, sizeof(_linkStats));
+#endif
 }
 
 // set up the ESP8266
@@ -83,12 +168,33 @@ bool ESP8266Class::begin(unsigned long baudRate, esp8266_serial_port serialPort)
             return false;
         }
 #endif
+        // the module may still have links open from before we were reset -
+        // after this the socket table is kept up to date by the link events
+        updateStatus();
         return true;
     }
 
     return false;
 }
 
+// set up the ESP8266 and look up the hosts we are going to connect to
+bool ESP8266Class::begin(unsigned long baudRate, esp8266_serial_port serialPort, const char * const hosts[], uint8_t count)
+{
+    if (!begin(baudRate, serialPort))
+    {
+        return false;
+    }
+
+    // (if the module hasn't joined the network yet these are looked up on
+    // the first connect instead)
+    IPAddress ip;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        resolve(hosts[i], ip);
+    }
+    return true;
+}
+
 ///////////////////////
 // Basic AT Commands //
 ///////////////////////
@@ -190,7 +296,7 @@ int16_t ESP8266Class::getVersion(char * ATversion, char * SDKversion, char * com
         char *p, *q;
 
         // look for "AT version" in the rxBuffer
-        p = strstr(esp8266RxBuffer, "AT version:");
+        p = searchBuffer("AT version:");
         if (p == NULL) return ESP8266_RSP_UNKNOWN;
         p += strlen("AT version:");
         q = strchr(p, '\r'); // Look for \r
@@ -198,7 +304,7 @@ int16_t ESP8266Class::getVersion(char * ATversion, char * SDKversion, char * com
         strncpy(ATversion, p, q - p);
 
         // look for "SDK version:" in the rxBuffer
-        p = strstr(esp8266RxBuffer, "SDK version:");
+        p = searchBuffer("SDK version:");
         if (p == NULL) return ESP8266_RSP_UNKNOWN;
         p += strlen("SDK version:");
         q = strchr(p, '\r'); // Look for \r
@@ -206,7 +312,7 @@ int16_t ESP8266Class::getVersion(char * ATversion, char * SDKversion, char * com
         strncpy(SDKversion, p, q - p);
 
         // look for "compile time:" in the rxBuffer
-        p = strstr(esp8266RxBuffer, "compile time:");
+        p = searchBuffer("compile time:");
         if (p == NULL) return ESP8266_RSP_UNKNOWN;
         p += strlen("compile time:");
         q = strchr(p, '\r'); // Look for \r
@@ -239,7 +345,7 @@ int16_t ESP8266Class::getMode()
     if (rsp > 0)
     {
         // then get the number after ':'
-        char * p = strchr(esp8266RxBuffer, ':');
+        char * p = searchBuffer(":");
         if (p != NULL)
         {
             char mode = *(p + 1);
@@ -279,7 +385,7 @@ int16_t ESP8266Class::setMode(esp8266_wifi_mode mode)
 //    - Fail: <0 (esp8266_cmd_rsp)
 int16_t ESP8266Class::connect(const char * ssid)
 {
-    connect(ssid, "");
+    return connect(ssid, "");
 }
 
 // connect()
@@ -289,23 +395,43 @@ int16_t ESP8266Class::connect(const char * ssid)
 //    - Fail: <0 (esp8266_cmd_rsp)
 int16_t ESP8266Class::connect(const char * ssid, const char * pwd)
 {
+    waitForIdle();
+    return waitForCommand(connectAsync(ssid, pwd));
+}
+
+// connectAsync()
+// Input: ssid and pwd const char's, and an optional completion callback
+// Output:
+//    - Success: command handle (>0) - the result of the command is the same
+//      as connect() and is passed to the callback or read from commandResult()
+//    - Fail: ESP8266_RSP_BUSY if another command is in progress
+int16_t ESP8266Class::connectAsync(const char * ssid, const char * pwd, esp8266_cmd_callback callback)
+{
+    if (busy())
+    {
+        return ESP8266_RSP_BUSY;
+    }
+
     // send connect command AT+CWJAP_DEF="ssid","pwd"
-    _serial->print("AT");
-    _serial->print(ESP8266_CONNECT_AP);
-    _serial->print("=\"");
-    _serial->print(ssid);
-    _serial->print("\"");
+    bool sent;
     if (pwd != NULL)
     {
-        _serial->print(',');
-        _serial->print("\"");
-        _serial->print(pwd);
-        _serial->print("\"");
+        sent = sendFormatted("AT%s=\"%s\",\"%s\"\r\n", ESP8266_CONNECT_AP, ssid, pwd);
+    }
+    else
+    {
+        sent = sendFormatted("AT%s=\"%s\"\r\n", ESP8266_CONNECT_AP, ssid);
+    }
+    if (!sent)
+    {
+        return ESP8266_CMD_BAD;
     }
-    _serial->print("\r\n");
 
-    // check for ok response
-    return readForResponses(RESPONSE_OK, RESPONSE_FAIL, WIFI_CONNECT_TIMEOUT);
+    // look for the ok response in the background
+    _matcher.reset();
+    _matcher.add(RESPONSE_OK);
+    _matcher.add(RESPONSE_FAIL);
+    return startCommand(WIFI_CONNECT_TIMEOUT, NULL, callback);
 }
 
 // get access point information
@@ -323,13 +449,13 @@ int16_t ESP8266Class::getAP(char * ssid)
     if (rsp > 0)
     {
         // look for "No AP"
-        if (strstr(esp8266RxBuffer, "No AP") != NULL)
+        if (searchBuffer("No AP") != NULL)
         {
             return 0;
         }
 
         // look for "+CWJAP"
-        char * p = strstr(esp8266RxBuffer, ESP8266_CONNECT_AP);
+        char * p = searchBuffer(ESP8266_CONNECT_AP);
         if (p != NULL)
         {
             p += strlen(ESP8266_CONNECT_AP) + 2;
@@ -397,6 +523,19 @@ int16_t ESP8266Class::status()
 // actually check the esp8266 status
 int16_t ESP8266Class::updateStatus()
 {
+    waitForIdle();
+    return waitForCommand(updateStatusAsync());
+}
+
+// check the esp8266 status in the background (the _status table is updated 
+// when the response arrives)
+int16_t ESP8266Class::updateStatusAsync(esp8266_cmd_callback callback)
+{
+    if (busy())
+    {
+        return ESP8266_RSP_BUSY;
+    }
+
     // Send AT+CIPSTATUS
     sendCommand(ESP8266_TCP_STATUS); 
                                      
@@ -418,89 +557,117 @@ int16_t ESP8266Class::updateStatus()
     // 0 : ESP8266 runs as client
     // 1 : ESP8266 runs as server
     
-    // check for OK response
-    int16_t rsp = readForResponse(RESPONSE_OK, COMMAND_RESPONSE_TIMEOUT);
-    if (rsp > 0)
-    {
-        char * p = searchBuffer("STATUS:");
-        if (p == NULL)
-            return ESP8266_RSP_UNKNOWN;
-
-        p += strlen("STATUS:");
-        _status.stat = (esp8266_connect_status)(*p - 48);
+    // look for the OK response in the background - with every link open the
+    // response is longer than the ring, so it is parsed a line at a time
+    _matcher.reset();
+    _matcher.add(RESPONSE_OK);
+    _statusListed = 0;
+    _statusHeader = false;
+    _statusOverflow = bufferOverflow;
+    int16_t handle = startCommand(COMMAND_RESPONSE_TIMEOUT, &ESP8266Class::completeStatus, callback);
+    _cmd.line = &ESP8266Class::statusLine;
+    return handle;
+}
 
+// finish off the _status table once the whole AT+CIPSTATUS response is in
+int16_t ESP8266Class::completeStatus(int16_t rsp)
+{
+    // if we got all of it this is a full resync of the socket table - any
+    // link that wasn't listed has gone (the links can be listed in any
+    // order), along with its place in the pool and the accept queue. 
+    // otherwise only the links we did see have been updated, as freeing a
+    // link that is still open would hand it to the next connect.
+    if ((rsp > 0) && _statusHeader && (bufferOverflow == _statusOverflow))
+    {
+        // (the module has just told us its status, so that stands)
+        esp8266_connect_status stat = _status.stat;
         for (int i = 0; i<ESP8266_MAX_SOCK_NUM; i++)
         {
-            p = strstr(p, "+CIPSTATUS:");
-            if (p == NULL)
+            if ((_statusListed & (1 << i)) == 0)
             {
-                // didn't find CIPSTATUS. Set linkID to 255.
-                for (int j = i; j<ESP8266_MAX_SOCK_NUM; j++)
-                    _status.ipstatus[j].linkID = 255;
-                return rsp;
+                closeLink(i);
             }
-            else
-            {
-                p += strlen("+CIPSTATUS:");
-
-                // find linkID
-                uint8_t linkId = *p - 48;
-                if (linkId >= ESP8266_MAX_SOCK_NUM)
-                    return rsp;
-                _status.ipstatus[linkId].linkID = linkId;
-
-                // find type (udp or tcp) - move the pointer p forward 3
-                p += 3;
-                if (*p == 'T')
-                {
-                    _status.ipstatus[linkId].type = ESP8266_TCP;
-                }
-                else if (*p == 'U')
-                {
-                    _status.ipstatus[linkId].type = ESP8266_UDP;
-                }
-                else
-                {
-                    _status.ipstatus[linkId].type = ESP8266_TYPE_UNDEFINED;
-                }
+        }
+        _status.stat = stat;
+    }
 
-                // find remoteIP - move the pointer p
-                p += 6;
-                for (uint8_t j = 0; j < 4; j++)
-                {
-                    char tempOctet[4];
-                    memset(tempOctet, 0, 4);
+    return rsp;
+}
 
-                    size_t octetLength = strspn(p, "0123456789");
-                    strncpy(tempOctet, p, octetLength);
-                    _status.ipstatus[linkId].remoteIP[j] = atoi(tempOctet);
+// parse a line of the response to AT+CIPSTATUS into the _status table
+void ESP8266Class::statusLine(char * line)
+{
+    char * p = strstr(line, "+CIPSTATUS:");
+    if (p == NULL)
+    {
+        p = strstr(line, "STATUS:");
+        if (p != NULL)
+        {
+            p += strlen("STATUS:");
+            _status.stat = (esp8266_connect_status)(*p - 48);
+            _statusHeader = true;
+        }
+        return;
+    }
+    p += strlen("+CIPSTATUS:");
+
+    // find linkID
+    uint8_t linkId = *p - 48;
+    if (linkId >= ESP8266_MAX_SOCK_NUM)
+        return;
+    _statusListed |= (1 << linkId);
+
+    // a link we didn't know about is opened the same way a CONNECT would
+    // (tetype is the last field, after the local port)
+    char * last = strrchr(p, ',');
+    esp8266_tetype tetype = ((last != NULL) && (last[1] == '1')) ? ESP8266_SERVER : ESP8266_CLIENT;
+    openLink(linkId, tetype);
+
+    // find type (udp or tcp) - move the pointer p forward 3
+    p += 3;
+    if (*p == 'T')
+    {
+        _status.ipstatus[linkId].type = ESP8266_TCP;
+    }
+    else if (*p == 'U')
+    {
+        _status.ipstatus[linkId].type = ESP8266_UDP;
+    }
+    else
+    {
+        _status.ipstatus[linkId].type = ESP8266_TYPE_UNDEFINED;
+    }
 
-                    p += (octetLength + 1);
-                }
+    // find remoteIP - move the pointer p
+    p += 6;
+    for (uint8_t j = 0; j < 4; j++)
+    {
+        char tempOctet[4];
+        memset(tempOctet, 0, 4);
 
-                // find port
-                p += 1;
-                char tempPort[6];
-                memset(tempPort, 0, 6);
-                size_t portLen = strspn(p, "0123456789");
-                strncpy(tempPort, p, portLen);
-                _status.ipstatus[linkId].port = atoi(tempPort);
-                p += portLen + 1;
-
-                // find tetype
-                if (*p == '0')
-                {
-                    _status.ipstatus[linkId].tetype = ESP8266_CLIENT;
-                }
-                else if (*p == '1')
-                {
-                    _status.ipstatus[linkId].tetype = ESP8266_SERVER;
-                }
-            }
+        size_t octetLength = strspn(p, "0123456789");
+        if (octetLength >= 4)
+        {
+            return;
         }
+        strncpy(tempOctet, p, octetLength);
+        _status.ipstatus[linkId].remoteIP[j] = atoi(tempOctet);
+
+        p += (octetLength + 1);
     }
 
-    return rsp;
+    // find port
+    p += 1;
+    char tempPort[6];
+    memset(tempPort, 0, 6);
+    size_t portLen = strspn(p, "0123456789");
+    if (portLen >= 6)
+    {
+        return;
+    }
+    strncpy(tempPort, p, portLen);
+    _status.ipstatus[linkId].port = atoi(tempPort);
+    _status.ipstatus[linkId].tetype = tetype;
 }
 
 // localIP()
@@ -523,7 +690,7 @@ IPAddress ESP8266Class::localIP()
     if (rsp > 0)
     {
         // look for "STAIP" in the rxBuffer
-        char * p = strstr(esp8266RxBuffer, "STAIP");
+        char * p = searchBuffer("STAIP");
         if (p != NULL)
         {
             IPAddress returnIP;
@@ -567,7 +734,7 @@ int16_t ESP8266Class::localMAC(char * mac)
     if (rsp > 0)
     {
         // look for "+CIPSTAMAC" in the response
-        char * p = strstr(esp8266RxBuffer, ESP8266_GET_STA_MAC);
+        char * p = searchBuffer(ESP8266_GET_STA_MAC);
         if (p != NULL)
         {
             p += strlen(ESP8266_GET_STA_MAC) + 2;
@@ -588,29 +755,258 @@ int16_t ESP8266Class::localMAC(char * mac)
 // establish a tcp connection
 int16_t ESP8266Class::tcpConnect(uint8_t linkID, const char * destination, uint16_t port, uint16_t keepAlive)
 {
+    waitForIdle();
+
+    // look the host up first (or get it from the cache), so the module
+    // doesn't have to - if the lookup failed the module's own one would too,
+    // and would take as long again, so only a lookup that couldn't be sent
+    // leaves it to the module
+    IPAddress ip;
+    char address[16];
+    const char * host = destination;
+    if (!isAddress(destination))
+    {
+        int16_t found = resolve(destination, ip);
+        if (found == ESP8266_RSP_SUCCESS)
+        {
+            sprintf(address, "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
+            host = address;
+        }
+        else if (found != ESP8266_CMD_BAD)
+        {
+            return found;
+        }
+    }
+
+    int16_t rsp = waitForCommand(tcpConnectAsync(linkID, host, port, keepAlive));
+
+    // the host may have moved - look it up again next time
+    if ((rsp < 0) && (host != destination))
+    {
+        forgetHost(destination);
+    }
+    return rsp;
+}
+
+// establish a tcp connection in the background
+int16_t ESP8266Class::tcpConnectAsync(uint8_t linkID, const char * destination, uint16_t port, uint16_t keepAlive, esp8266_cmd_callback callback)
+{
+    if (linkID >= ESP8266_MAX_SOCK_NUM)
+    {
+        return ESP8266_CMD_BAD;
+    }
+    if (busy())
+    {
+        return ESP8266_RSP_BUSY;
+    }
+
+    // use the cached address for the host if we have one
+    char address[16];
+    destination = cachedAddress(destination, address);
+
     // send the AT+CIPSTART=0,"TCP","url",80
-    print("AT");
-    print(ESP8266_TCP_CONNECT);
-    print('=');
-    print(linkID);
-    print(',');
-    print("\"TCP\",");
-    print("\"");
-    print(destination);
-    print("\",");
-    print(port);
+    bool sent;
     if (keepAlive > 0)
     {
-        print(',');
         // keepAlive is in units of 500 milliseconds.
         // Max is 7200 * 500 = 3600000 ms = 60 minutes.
-        print(keepAlive / 500);
+        sent = sendFormatted("AT%s=%u,\"TCP\",\"%s\",%u,%u\r\n", ESP8266_TCP_CONNECT, 
+                             linkID, destination, port, keepAlive / 500);
+    }
+    else
+    {
+        sent = sendFormatted("AT%s=%u,\"TCP\",\"%s\",%u\r\n", ESP8266_TCP_CONNECT, 
+                             linkID, destination, port);
+    }
+    if (!sent)
+    {
+        return ESP8266_CMD_BAD;
+    }
+    return startConnect(linkID, ESP8266_TCP, port, callback);
+}
+
+// open several tcp connections, one after the other with no gaps
+int16_t ESP8266Class::tcpConnectMany(esp8266_connect_target targets[], uint8_t count)
+{
+    waitForIdle();
+
+    // look up all the hosts first so they all go from the cache
+    IPAddress ip;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (!isAddress(targets[i].host))
+        {
+            resolve(targets[i].host, ip);
+        }
+    }
+
+    if (tcpConnectManyAsync(targets, count) < 0)
+    {
+        return ESP8266_RSP_BUSY;
+    }
+    while (connectingMany())
+    {
+        poll();
+    }
+    return _batch.connected;
+}
+
+// open several tcp connections in the background - the firmware won't take
+// another AT+CIPSTART until the last one has finished (it just says 
+// "busy p..."), so the best we can do is send each one the moment it can
+int16_t ESP8266Class::tcpConnectManyAsync(esp8266_connect_target targets[], uint8_t count, esp8266_cmd_callback callback)
+{
+    if (connectingMany())
+    {
+        return ESP8266_RSP_BUSY;
+    }
+
+    // hand out the free links now, so nothing else takes them while we work
+    // through the list (a link that is already someone else's is refused -
+    // we mustn't connect it again, or give it back if we fail)
+    _batch.claimed = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        targets[i].result = ESP8266_RSP_PENDING;
+        if (targets[i].linkID == ESP8266_SOCK_NOT_AVAIL)
+        {
+            for (uint8_t j = 0; j < ESP8266_MAX_SOCK_NUM; j++)
+            {
+                if (_state[j] == AVAILABLE)
+                {
+                    targets[i].linkID = j;
+                    break;
+                }
+            }
+        }
+        if (targets[i].linkID < ESP8266_MAX_SOCK_NUM)
+        {
+            if (_state[targets[i].linkID] == AVAILABLE)
+            {
+                _state[targets[i].linkID] = TAKEN;
+                _batch.claimed |= (1 << targets[i].linkID);
+            }
+            else
+            {
+                targets[i].result = ESP8266_CMD_BAD;
+            }
+        }
+    }
+
+    _batch.targets = targets;
+    _batch.count = count;
+    _batch.next = 0;
+    _batch.connected = 0;
+    _batch.callback = callback;
+    startNextTarget();
+    return ESP8266_RSP_SUCCESS;
+}
+
+bool ESP8266Class::connectingMany()
+{
+    return (_batch.targets != NULL);
+}
+
+// send the AT+CIPSTART for the next target (skipping any we couldn't start)
+// - if another command has the engine, poll() tries again once it is free
+void ESP8266Class::startNextTarget()
+{
+    while (_batch.next < _batch.count)
+    {
+        esp8266_connect_target & target = _batch.targets[_batch.next];
+        if (target.result != ESP8266_RSP_PENDING)
+        {
+            _batch.next++;
+            continue;
+        }
+
+        int16_t handle = ESP8266_RSP_MEMORY_ERR;
+        if (target.linkID < ESP8266_MAX_SOCK_NUM)
+        {
+            handle = whenDone(tcpConnectAsync(target.linkID, target.host, target.port, target.keepAlive),
+                              targetComplete, this);
+        }
+        if ((handle > 0) || (handle == ESP8266_RSP_BUSY))
+        {
+            return;
+        }
+
+        // no free link, or the command couldn't be sent
+        target.result = handle;
+        if ((target.linkID < ESP8266_MAX_SOCK_NUM) && (_batch.claimed & (1 << target.linkID)))
+        {
+            _state[target.linkID] = AVAILABLE;
+        }
+        _batch.next++;
+    }
+
+    // all done
+    esp8266_cmd_callback callback = _batch.callback;
+    _batch.targets = NULL;
+    if (callback != NULL)
+    {
+        callback(0, _batch.connected);
+    }
+}
+
+void ESP8266Class::targetComplete(void * context, int16_t result)
+{
+    // the engine is free by the time we get here, so the next connection
+    // can go straight away
+    ESP8266Class & esp = *(ESP8266Class *)context;
+    esp._batch.targets[esp._batch.next].result = result;
+    if (result > 0)
+    {
+        esp._batch.connected++;
+    }
+    esp._batch.next++;
+    esp.startNextTarget();
+}
+
+// register a udp port (mode 0 only talks to destination, mode 2 will take
+// datagrams from anywhere and send to wherever udpSend() says)
+int16_t ESP8266Class::udpConnect(uint8_t linkID, const char * destination, uint16_t port, uint16_t localPort, uint8_t mode)
+{
+    if (linkID >= ESP8266_MAX_SOCK_NUM)
+    {
+        return ESP8266_CMD_BAD;
+    }
+
+    // send AT+CIPSTART=0,"UDP","0.0.0.0",0,5000,2
+    if (!sendFormatted("AT%s=%u,\"UDP\",\"%s\",%u,%u,%u\r\n", ESP8266_TCP_CONNECT, 
+                       linkID, destination, port, localPort, mode))
+    {
+        return ESP8266_CMD_BAD;
     }
-    print("\r\n");
+    return waitForCommand(startConnect(linkID, ESP8266_UDP, port, NULL));
+}
+
+// wait for the response to AT+CIPSTART
+int16_t ESP8266Class::startConnect(uint8_t linkID, esp8266_connection_type type, uint16_t port, esp8266_cmd_callback callback)
+{
     // Example good: CONNECT\r\n\r\nOK\r\n
     // Example bad:  DNS Fail\r\n\r\nERROR\r\n
     // Example meh:  ALREADY CONNECTED\r\n\r\nERROR\r\n
-    int16_t rsp = readForResponses(RESPONSE_OK, RESPONSE_ERROR, CLIENT_CONNECT_TIMEOUT);
+    if (linkID >= ESP8266_MAX_SOCK_NUM)
+    {
+        return ESP8266_CMD_BAD;
+    }
+    _urc.opening |= (1 << linkID);
+    _cmd.link = linkID;
+    _status.ipstatus[linkID].type = type;
+    _status.ipstatus[linkID].remoteIP = IPAddress(0, 0, 0, 0);
+    _status.ipstatus[linkID].port = port;
+    _matcher.reset();
+    _matcher.add(RESPONSE_OK);
+    _matcher.add(RESPONSE_ERROR);
+    return startCommand(CLIENT_CONNECT_TIMEOUT, &ESP8266Class::completeTcpConnect, callback);
+}
+
+// work out the result of AT+CIPSTART
+int16_t ESP8266Class::completeTcpConnect(int16_t rsp)
+{
+    // any CONNECT for this link has been seen by now
+    _urc.opening = 0;
 
     if (rsp < 0)
     {
@@ -619,51 +1015,135 @@ int16_t ESP8266Class::tcpConnect(uint8_t linkID, const char * destination, uint1
         char * p = searchBuffer("ALREADY");
         if (p != NULL)
         {
+            openLink(_cmd.link, ESP8266_CLIENT);
             return 2;
         }
         // otherwise the connection failed. Return the error code:
+        closeLink(_cmd.link);
         return rsp;
     }
     // return 1 on successful (new) connection
+    openLink(_cmd.link, ESP8266_CLIENT);
     return 1;
 }
 
 // send tcp data
 int16_t ESP8266Class::tcpSend(uint8_t linkID, const uint8_t *buf, size_t size)
 {
-    // check whether we are trying to send more data than we can manage
-    if (size > 2048)
+    waitForIdle();
+    return waitForCommand(tcpSendAsync(linkID, buf, size));
+}
+
+// send tcp data in the background (note: buf must stay valid until the 
+// command has completed)
+int16_t ESP8266Class::tcpSendAsync(uint8_t linkID, const uint8_t *buf, size_t size, esp8266_cmd_callback callback)
+{
+    // check whether we are trying to send more data than we can report back
+    // (anything over ESP8266_TCP_SEGMENT_SIZE is split up for us)
+    if ((linkID >= ESP8266_MAX_SOCK_NUM) || (size == 0) || (size > 0x7FFF))
+    {
+        return ESP8266_CMD_BAD;
+    }
+    if (busy())
+    {
+        return ESP8266_RSP_BUSY;
+    }
+
+    _cmd.link = linkID;
+    _cmd.payload = buf;
+    _cmd.payloadLen = size;
+    _cmd.payloadSent = 0;
+    _cmd.remote = NULL;
+
+    int16_t handle = startCommand(COMMAND_RESPONSE_TIMEOUT, &ESP8266Class::completeTcpSend, callback);
+    startSegment();
+
+    return handle;
+}
+
+// send a udp datagram to destination:port (the link needs to have been 
+// opened in mode 2 to send anywhere other than where it was opened to)
+int16_t ESP8266Class::udpSend(uint8_t linkID, const uint8_t *buf, size_t size, const char * destination, uint16_t port)
+{
+    // a datagram can't be split up
+    if ((linkID >= ESP8266_MAX_SOCK_NUM) || (size == 0) || (size > ESP8266_TCP_SEGMENT_SIZE))
     {
         return ESP8266_CMD_BAD;
     }
+    waitForIdle();
+
+    _cmd.link = linkID;
+    _cmd.payload = buf;
+    _cmd.payloadLen = size;
+    _cmd.payloadSent = 0;
+    _cmd.remote = destination;
+    _cmd.remotePort = port;
+
+    int16_t handle = startCommand(COMMAND_RESPONSE_TIMEOUT, &ESP8266Class::completeTcpSend);
+    startSegment();
+
+    return waitForCommand(handle);
+}
 
-    // copy the information about the data into the paramter string and send
-    // AT+CIPSEND=0,52
-    char params[8];
-    sprintf(params, "%d,%d", linkID, size);
-    sendCommand(ESP8266_TCP_SEND, ESP8266_CMD_SETUP, params);
+// send the AT+CIPSEND for the next segment of the payload, and wait for the 
+// prompt - the engine then sends the segment and waits for the SEND OK
+void ESP8266Class::startSegment()
+{
+    _cmd.segmentLen = min(_cmd.payloadLen - _cmd.payloadSent, (size_t)ESP8266_TCP_SEGMENT_SIZE);
+    _cmd.start = millis();
 
-    // check for the Ok response
-    int16_t rsp = readForResponses(RESPONSE_OK, RESPONSE_ERROR, COMMAND_RESPONSE_TIMEOUT);
-    if (rsp != ESP8266_RSP_FAIL)
+    if (_cmd.remote != NULL)
     {
-        // send all the data
-        // E.g.
-        // GET / HTTP/1.1
-        // Host: example.com
-        // Connection: close
-        for (size_t i = 0; i < size; i++)
+        // AT+CIPSEND=0,52,"192.168.0.10",5000
+        if (!writeFormatted("AT%s=%u,%u,\"%s\",%u\r\n", ESP8266_TCP_SEND, _cmd.link, 
+                            (unsigned int)_cmd.segmentLen, _cmd.remote, _cmd.remotePort))
         {
-            write(buf[i]);
+            // let the timeout finish it off
+            _cmd.state = ESP8266_CMD_WAIT_RESPONSE;
+            return;
         }
-
-        // check we have sent the data ok
-        rsp = readForResponse("SEND OK", COMMAND_RESPONSE_TIMEOUT);
-    
-        // return the size of the data sent
-        if (rsp > 0) {
-            return size;
+    }
+    else if (_window[_cmd.link].mode == ESP8266_SEND_DIRECT)
+    {
+        // AT+CIPSEND=0,52
+        writeFormatted("AT%s=%u,%u\r\n", ESP8266_TCP_SEND, _cmd.link, (unsigned int)_cmd.segmentLen);
+    }
+    else
+    {
+        // only give the module as much as it has room for - if it is full,
+        // poll() tries again when the SEND OKs come in
+        int room = availableForWrite(_cmd.link);
+        if (room == 0)
+        {
+            _cmd.state = ESP8266_CMD_WAIT_WINDOW;
+            return;
         }
+        _cmd.segmentLen = min(_cmd.segmentLen, (size_t)room);
+
+        // AT+CIPSENDBUF=0,52 (the segment ID comes back before the prompt)
+        clearBuffer();
+        writeFormatted("AT%s=%u,%u\r\n", ESP8266_TCP_SEND_BUF, _cmd.link, (unsigned int)_cmd.segmentLen);
+    }
+
+    _matcher.reset();
+    _matcher.add(RESPONSE_PROMPT);
+    _matcher.add(RESPONSE_ERROR);
+    _matcher.add(RESPONSE_BUSY);
+    _cmd.state = ESP8266_CMD_WAIT_PROMPT;
+}
+
+// work out the result of AT+CIPSEND
+int16_t ESP8266Class::completeTcpSend(int16_t rsp)
+{
+    // return the size of the data sent (if we got part of the way through a
+    // long payload before it failed, that is how much was sent)
+    if (rsp > 0)
+    {
+        return _cmd.payloadLen;
+    }
+    if (_cmd.payloadSent > 0)
+    {
+        return _cmd.payloadSent;
     }
     return rsp;
 }
@@ -678,7 +1158,12 @@ int16_t ESP8266Class::close(uint8_t linkID)
 
     // Eh, client virtual function doesn't have a return value.
     // We'll wait for the OK or timeout anyway.
-    return readForResponse(RESPONSE_OK, COMMAND_RESPONSE_TIMEOUT);
+    int16_t rsp = readForResponse(RESPONSE_OK, COMMAND_RESPONSE_TIMEOUT);
+    if ((rsp > 0) && (linkID < ESP8266_MAX_SOCK_NUM))
+    {
+        closeLink(linkID);
+    }
+    return rsp;
 }
 
 int16_t ESP8266Class::setTransferMode(uint8_t mode)
@@ -699,6 +1184,16 @@ int16_t ESP8266Class::setMux(bool enable)
     return readForResponse(RESPONSE_OK, COMMAND_RESPONSE_TIMEOUT);
 }
 
+// show the remote ip and port in +IPD (needed to know who sent a udp
+// datagram)
+int16_t ESP8266Class::setDataInfo(bool enable)
+{
+    char params[2] = { 0, 0 };
+    params[0] = enable ? '1' : '0';
+    sendCommand(ESP8266_DATA_INFO, ESP8266_CMD_SETUP, params);
+    return readForResponse(RESPONSE_OK, COMMAND_RESPONSE_TIMEOUT);
+}
+
 // set up a tcp server (need to first set AT+CIPMUX=1)
 int16_t ESP8266Class::configureTCPServer(uint16_t port, uint8_t create)
 {
@@ -720,23 +1215,46 @@ int16_t ESP8266Class::ping(IPAddress ip)
 // send the ping request
 int16_t ESP8266Class::ping(char * server)
 {
-    // format the parameter string
-    char params[strlen(server) + 3];
-    sprintf(params, "\"%s\"", server);
-    
-    // send AT+Ping=<server>
+    waitForIdle();
+    return waitForCommand(pingAsync(server));
+}
+
+// send the ping request in the background
+int16_t ESP8266Class::pingAsync(char * server, esp8266_cmd_callback callback)
+{
+    if (busy())
+    {
+        return ESP8266_RSP_BUSY;
+    }
+
+    // format the parameter string
+    char params[strlen(server) + 3];
+    sprintf(params, "\"%s\"", server);
+    
+    // send AT+Ping=<server>
     sendCommand(ESP8266_PING, ESP8266_CMD_SETUP, params);
 
     // Example responses:
     //  * Good response: +12\r\n\r\nOK\r\n
     //  * Timeout response: +timeout\r\n\r\nERROR\r\n
     //  * Error response (unreachable): ERROR\r\n\r\n
-    int16_t rsp = readForResponses(RESPONSE_OK, RESPONSE_ERROR, COMMAND_PING_TIMEOUT);
-    
+    _matcher.reset();
+    _matcher.add(RESPONSE_OK);
+    _matcher.add(RESPONSE_ERROR);
+    return startCommand(COMMAND_PING_TIMEOUT, &ESP8266Class::completePing, callback);
+}
+
+// parse the ping response time
+int16_t ESP8266Class::completePing(int16_t rsp)
+{
     // parse the ping response time
     if (rsp > 0)
     {
         char * p = searchBuffer("+");
+        if (p == NULL)
+        {
+            return ESP8266_RSP_UNKNOWN;
+        }
         p += 1;
         char * q = strchr(p, '\r');
         if (q == NULL)
@@ -749,37 +1267,341 @@ int16_t ESP8266Class::ping(char * server)
     }
     else
     {
+        // the module gave up waiting for the reply
         if (searchBuffer("timeout") != NULL)
         {
-            return 0;
+            return ESP8266_RSP_TIMEOUT;
+        }
+    }
+
+    return rsp;
+}
+
+//////////////////////
+// Buffered Sending //
+//////////////////////
+
+// choose how the link's data is sent
+int16_t ESP8266Class::setSendMode(uint8_t linkID, esp8266_send_mode mode)
+{
+    if (linkID >= ESP8266_MAX_SOCK_NUM)
+    {
+        return ESP8266_CMD_BAD;
+    }
+
+    // don't change the mode under a send that is in progress
+    if (busy() && (_cmd.link == linkID) && (_cmd.payload != NULL))
+    {
+        return ESP8266_RSP_BUSY;
+    }
+
+    // AT+CIPSENDBUF is tcp only
+    if ((mode == ESP8266_SEND_BUFFERED) && (_status.ipstatus[linkID].type == ESP8266_UDP) &&
+        (_status.ipstatus[linkID].linkID == linkID))
+    {
+        return ESP8266_CMD_BAD;
+    }
+
+    _window[linkID].mode = mode;
+    resetWindow(linkID);
+    return ESP8266_RSP_SUCCESS;
+}
+
+// how much more the module can take for this link straight away
+int ESP8266Class::availableForWrite(uint8_t linkID)
+{
+    if (linkID >= ESP8266_MAX_SOCK_NUM)
+    {
+        return 0;
+    }
+
+    // AT+CIPSEND waits for the SEND OK, so there is only ever one segment
+    if (_window[linkID].mode == ESP8266_SEND_DIRECT)
+    {
+        return ESP8266_TCP_SEGMENT_SIZE;
+    }
+
+    // otherwise we are limited by the window and by the segments we can
+    // keep track of
+    if ((_window[linkID].queued >= ESP8266_SEND_QUEUE_LEN) ||
+        (_window[linkID].inflight >= ESP8266_SEND_WINDOW))
+    {
+        return 0;
+    }
+    return ESP8266_SEND_WINDOW - _window[linkID].inflight;
+}
+
+// ask the module which segments it has sent
+int16_t ESP8266Class::updateSendStatus(uint8_t linkID)
+{
+    if (linkID >= ESP8266_MAX_SOCK_NUM)
+    {
+        return ESP8266_CMD_BAD;
+    }
+
+    // send AT+CIPBUFSTATUS=0
+    if (!sendFormatted("AT%s=%u\r\n", ESP8266_TCP_BUF_STATUS, linkID))
+    {
+        return ESP8266_CMD_BAD;
+    }
+
+    // Example Response:
+    // +CIPBUFSTATUS:<next segment ID>,<segment ID sent>,<segment ID acked>,
+    //   <remaining buffer size>,<queue number>
+    _cmd.link = linkID;
+    _matcher.reset();
+    _matcher.add(RESPONSE_OK);
+    _matcher.add(RESPONSE_ERROR);
+    return waitForCommand(startCommand(COMMAND_RESPONSE_TIMEOUT, &ESP8266Class::completeSendStatus));
+}
+
+// parse the response to AT+CIPBUFSTATUS and drop anything that has been acked
+int16_t ESP8266Class::completeSendStatus(int16_t rsp)
+{
+    if (rsp > 0)
+    {
+        char * p = searchBuffer("+CIPBUFSTATUS:");
+        if (p == NULL)
+        {
+            return ESP8266_RSP_UNKNOWN;
+        }
+        p += strlen("+CIPBUFSTATUS:");
+
+        unsigned long field[4];
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            char * end;
+            field[i] = strtoul(p, &end, 10);
+            if ((end == p) || (*end != ','))
+            {
+                return ESP8266_RSP_UNKNOWN;
+            }
+            p = end + 1;
         }
+
+        // the module numbers the segments, so go with its idea of what comes
+        // next
+        esp8266_send_window & window = _window[_cmd.link];
+        window.nextSegment = field[0];
+        ackSegment(_cmd.link, field[2]);
+
+        return min(field[3], (unsigned long)0x7FFF);
     }
 
     return rsp;
 }
 
+// the module has taken the segment that has just been sent - AT+CIPSENDBUF
+// told us its ID (<segment ID>,<length>) before the prompt
+void ESP8266Class::queueSegment()
+{
+    esp8266_send_window & window = _window[_cmd.link];
+
+    uint16_t segment = window.nextSegment;
+    char pattern[10];
+    sprintf(pattern, ",%u\r\n", (unsigned int)_cmd.segmentLen);
+    char * p = searchBuffer(pattern);
+    if (p != NULL)
+    {
+        char * q = p;
+        while ((q > esp8266RxBuffer) && (q[-1] >= '0') && (q[-1] <= '9'))
+        {
+            q--;
+        }
+        if (q < p)
+        {
+            segment = atoi(q);
+        }
+    }
+    window.nextSegment = segment + 1;
+
+    // startSegment() made sure there was room for it
+    if (window.queued < ESP8266_SEND_QUEUE_LEN)
+    {
+        uint8_t tail = (window.head + window.queued) % ESP8266_SEND_QUEUE_LEN;
+        window.segment[tail] = segment;
+        window.length[tail] = _cmd.segmentLen;
+#ifdef ESP8266_STATS
+        window.sent[tail] = millis();
+#endif
+        window.queued++;
+        window.inflight += _cmd.segmentLen;
+    }
+}
+
+// segments are sent in order, so a SEND OK (or SEND FAIL) for one segment 
+// means the module is done with everything before it too
+void ESP8266Class::ackSegment(uint8_t linkID, uint16_t segment)
+{
+    esp8266_send_window & window = _window[linkID];
+    while ((window.queued > 0) && ((int16_t)(segment - window.segment[window.head]) >= 0))
+    {
+#ifdef ESP8266_STATS
+        linkRtt(linkID, window.sent[window.head]);
+#endif
+        window.inflight -= window.length[window.head];
+        window.head = (window.head + 1) % ESP8266_SEND_QUEUE_LEN;
+        window.queued--;
+    }
+}
+
+void ESP8266Class::resetWindow(uint8_t linkID)
+{
+    esp8266_send_window & window = _window[linkID];
+    window.nextSegment = 1;
+    window.inflight = 0;
+    window.head = 0;
+    window.queued = 0;
+}
+
+/////////////////
+// Passthrough //
+/////////////////
+
+bool ESP8266Class::passthrough()
+{
+    return _passthrough;
+}
+
+// connect to the server as our only link and hand the uart over to it
+int16_t ESP8266Class::startPassthrough(const char * destination, uint16_t port, uint16_t keepAlive)
+{
+    if (_passthrough)
+    {
+        return ESP8266_RSP_BUSY;
+    }
+
+    // passthrough only works with a single connection (this fails if there
+    // are links open or a server running)
+    int16_t rsp = setMux(false);
+    if (rsp < 0)
+    {
+        return rsp;
+    }
+
+    rsp = setTransferMode(1);
+    if (rsp >= 0)
+    {
+        // send the AT+CIPSTART="TCP","url",80
+        bool sent;
+        if (keepAlive > 0)
+        {
+            sent = sendFormatted("AT%s=\"TCP\",\"%s\",%u,%u\r\n", ESP8266_TCP_CONNECT, 
+                                 destination, port, keepAlive / 500);
+        }
+        else
+        {
+            sent = sendFormatted("AT%s=\"TCP\",\"%s\",%u\r\n", ESP8266_TCP_CONNECT, 
+                                 destination, port);
+        }
+        rsp = sent ? readForResponses(RESPONSE_OK, RESPONSE_ERROR, CLIENT_CONNECT_TIMEOUT) : (int16_t)ESP8266_CMD_BAD;
+    }
+    if (rsp >= 0)
+    {
+        // AT+CIPSEND with no length - everything after the prompt goes
+        // straight to the server
+        sendCommand(ESP8266_TCP_SEND);
+        rsp = readForResponses(RESPONSE_PROMPT, RESPONSE_ERROR, COMMAND_RESPONSE_TIMEOUT);
+    }
+
+    if (rsp < 0)
+    {
+        // put things back how begin() left them
+        sendCommand(ESP8266_TCP_CLOSE);
+        readForResponses(RESPONSE_OK, RESPONSE_ERROR, COMMAND_RESPONSE_TIMEOUT);
+        setTransferMode(0);
+        setMux(true);
+        return rsp;
+    }
+
+    _passthrough = true;
+    return ESP8266_RSP_SUCCESS;
+}
+
+// leave passthrough mode and go back to normal AT commands
+int16_t ESP8266Class::stopPassthrough()
+{
+    if (!_passthrough)
+    {
+        return ESP8266_RSP_SUCCESS;
+    }
+
+    // the module only treats "+++" as the end of the session if it arrives
+    // as a packet on its own
+    _serial->flush();
+    delay(ESP8266_PASSTHROUGH_GUARD);
+    serialWrite((const uint8_t *)"+++", 3);
+    _serial->flush();
+    delay(ESP8266_PASSTHROUGH_GUARD);
+    _passthrough = false;
+
+    // anything the server sent that hasn't been read is lost
+    while (_serial->available() > 0)
+    {
+        serialRead();
+    }
+
+    // close the link (ERROR just means the server already has) and go back
+    // to normal transfer mode and multiple connections
+    setTransferMode(0);
+    sendCommand(ESP8266_TCP_CLOSE);
+    readForResponses(RESPONSE_OK, RESPONSE_ERROR, COMMAND_RESPONSE_TIMEOUT);
+    int16_t rsp = setMux(true);
+    return (rsp > 0) ? (int16_t)ESP8266_RSP_SUCCESS : rsp;
+}
+
 //////////////////////////////
 // Stream Virtual Functions //
 //////////////////////////////
 
 size_t ESP8266Class::write(uint8_t c)
 {
-    _serial->write(c);
+    return serialWrite(&c, 1);
+}
+
+size_t ESP8266Class::write(const uint8_t *buf, size_t size)
+{
+    return serialWrite(buf, size);
 }
 
+// the stream functions give the payload data from +IPD frames on any link 
+// (the frame headers and any other AT traffic are dealt with by poll())
 int ESP8266Class::available()
 {
-    return _serial->available();
+    poll();
+
+    int total = 0;
+    for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+    {
+        total += _receiveBuffer.available(i);
+    }
+    return total;
 }
 
 int ESP8266Class::read()
 {
-    return _serial->read();
+    poll();
+    for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+    {
+        if (_receiveBuffer.available(i) > 0)
+        {
+            return _receiveBuffer.read(i);
+        }
+    }
+    return -1;
 }
 
 int ESP8266Class::peek()
 {
-    return _serial->peek();
+    poll();
+    for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+    {
+        if (_receiveBuffer.available(i) > 0)
+        {
+            return _receiveBuffer.peek(i);
+        }
+    }
+    return -1;
 }
 
 void ESP8266Class::flush()
@@ -793,133 +1615,1242 @@ void ESP8266Class::flush()
 
 void ESP8266Class::sendCommand(const char * cmd, enum esp8266_command_type type, const char * params)
 {
-    _serial->print("AT");
-    _serial->print(cmd);
     if (type == ESP8266_CMD_QUERY)
-        _serial->print('?');
+    {
+        sendFormatted("AT%s?\r\n", cmd);
+    }
     else if (type == ESP8266_CMD_SETUP)
     {
-        _serial->print("=");
-        _serial->print(params);
+        sendFormatted("AT%s=%s\r\n", cmd, params);
+    }
+    else
+    {
+        sendFormatted("AT%s\r\n", cmd);
     }
-    _serial->print("\r\n");
 }
 
-// check the data received from the esp8266 for a specific response
-int16_t ESP8266Class::readForResponse(const char * rsp, unsigned int timeout)
+// format a whole command into the staging buffer and send it with a single 
+// write (rather than a print() for every piece)
+bool ESP8266Class::sendFormatted(const char * format, ...)
 {
-    // timestamp coming into function (so we can keep track of timeouts)
-    unsigned long timeIn = millis();    
-    unsigned int received = 0;
+    // don't talk over a command that is still waiting for its response
+    waitForIdle();
 
-    clearBuffer();
-    while (timeIn + timeout > millis())
+    va_list args;
+    va_start(args, format);
+    bool sent = vwriteFormatted(format, args);
+    va_end(args);
+
+    return sent;
+}
+
+// as sendFormatted(), but without waiting (for use by the command engine)
+bool ESP8266Class::writeFormatted(const char * format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    bool sent = vwriteFormatted(format, args);
+    va_end(args);
+
+    return sent;
+}
+
+bool ESP8266Class::vwriteFormatted(const char * format, va_list args)
+{
+#ifdef ESP8266_STATS
+    // a command that isn't sent mustn't be counted as the last one that was
+    _statsCommand = ESP8266_STATS_OTHER;
+#endif
+
+    // in passthrough mode the command would just go to the server
+    if (_passthrough)
     {
-        // if data is available on UART RX
-        if (_serial->available()) 
-        {
-            // read it into the buffer and search the buffer
-            // for the queried response string
-            received += readByteToBuffer();
-            if (searchBuffer(rsp))
-            {
-                return received;
-            }
-        }
+        return false;
     }
 
-    // otherwise, we've received some data but don't understand it
-    if (received > 0)
+    int len = vsnprintf(esp8266TxBuffer, ESP8266_TX_BUFFER_LEN, format, args);
+
+    // don't send half a command
+    if ((len < 0) || (len >= ESP8266_TX_BUFFER_LEN))
     {
-        return ESP8266_RSP_UNKNOWN;
+        return false;
     }
-    else 
+
+    serialWrite((const uint8_t *)esp8266TxBuffer, len);
+
+#ifdef ESP8266_STATS
+    // remember what this was for when its response is waited for
+    if (strncmp(esp8266TxBuffer, "AT", 2) == 0)
     {
-        return ESP8266_RSP_TIMEOUT;
+        _statsCommand = statsCommand(esp8266TxBuffer + 2);
     }
+#endif
+    return true;
+}
+
+// check the data received from the esp8266 for a specific response
+int16_t ESP8266Class::readForResponse(const char * rsp, unsigned int timeout)
+{
+    // build the response matcher once for this command
+    waitForIdle();
+    _matcher.reset();
+    _matcher.add(rsp);
+
+    return waitForCommand(startCommand(timeout));
 }
 
 // check the data received from the esp8266 for specific responses indicating pass or fail
 int16_t ESP8266Class::readForResponses(const char * pass, const char * fail, unsigned int timeout)
 {
-    // timestamp coming into function (so we can keep track of timeouts)
-    unsigned long timeIn = millis();    
-    unsigned int received = 0;
+    // build the response matcher once for this command - pass is pattern 0 and 
+    // fail is pattern 1, and both are checked in the same pass over each byte
+    waitForIdle();
+    _matcher.reset();
+    _matcher.add(pass);
+    _matcher.add(fail);
+
+    return waitForCommand(startCommand(timeout));
+}
 
-    clearBuffer();
-    while (timeIn + timeout > millis())
+////////////////////
+// Command Engine //
+////////////////////
+
+// is there a command waiting for its response?
+bool ESP8266Class::busy()
+{
+    return (_cmd.state != ESP8266_CMD_IDLE);
+}
+
+// get the result of a command started with one of the ...Async() functions
+// (ESP8266_RSP_PENDING while it is still running) - the engine may have 
+// started something else since it finished, so the last few results are kept
+int16_t ESP8266Class::commandResult(int16_t handle)
+{
+    if (handle < 0)
     {
-        // if data is available on UART RX
-        if (_serial->available()) 
-        {
-            // read it into the buffer and search the buffer
-            // for the queried response string
-            received += readByteToBuffer();
-            if (searchBuffer(pass))
-            {
-                return received;
-            }
-            if (searchBuffer(fail))
-            {
-                return ESP8266_RSP_FAIL;
-            }
-        }
+        return handle;
     }
-
-    // otherwise, we've received some data but don't understand it
-    if (received > 0)
+    if ((handle == _cmd.handle) && busy())
     {
-        return ESP8266_RSP_UNKNOWN;
+        return ESP8266_RSP_PENDING;
     }
-    else 
+    for (uint8_t i = 0; i < ESP8266_CMD_RESULTS; i++)
     {
-        return ESP8266_RSP_TIMEOUT;
+        if (_results[i].handle == handle)
+        {
+            return _results[i].result;
+        }
     }
+    return ESP8266_RSP_UNKNOWN;
 }
 
-//////////////////
-// Buffer Stuff //
-//////////////////
-void ESP8266Class::clearBuffer()
+// arm the engine to wait for the response to the command we have just sent 
+// (the responses we are waiting for need to be in _matcher already - pattern 
+// 0 is a pass, anything else is a fail)
+int16_t ESP8266Class::startCommand(unsigned int timeout, esp8266_cmd_complete complete, esp8266_cmd_callback callback)
 {
-    memset(esp8266RxBuffer, '\0', ESP8266_RX_BUFFER_LEN);
-    bufferHead = 0;
-}
+    // handles count up from 1 (wrapping round)
+    _cmd.handle = (_cmd.handle % 127) + 1;
+    _cmd.state = (_cmd.payload != NULL) ? ESP8266_CMD_WAIT_PROMPT : ESP8266_CMD_WAIT_RESPONSE;
+    _cmd.start = millis();
+    _cmd.timeout = timeout;
+    _cmd.received = 0;
+    _cmd.result = ESP8266_RSP_PENDING;
+    _cmd.complete = complete;
+    _cmd.line = NULL;
+    _cmd.callback = callback;
+    _cmd.done = NULL;
+
+#ifdef ESP8266_STATS
+    // (the AT+CIPSEND for a payload is sent after this)
+    if (_cmd.payload != NULL)
+    {
+        _statsCommand = ESP8266_STATS_SEND;
+    }
+    _stats.command[_statsCommand].issued++;
+    _statsStart = micros();
+#endif
 
-unsigned int ESP8266Class::readByteToBuffer()
-{
-    // read the data in
-    char c = _serial->read();
+    clearBuffer();
 
-    // store the data in the buffer
-    esp8266RxBuffer[bufferHead] = c;
-    
-    //! TODO: Don't care if we overflow. Should we? Set a flag or something?
-    bufferHead = (bufferHead + 1) % ESP8266_RX_BUFFER_LEN;
+    // a response the matcher couldn't take would never be spotted, and the
+    // command could only end by timing out (a payload's patterns are added
+    // by startSegment() after this)
+    if ((_cmd.payload == NULL) && _matcher.dropped())
+    {
+        finishCommand(ESP8266_CMD_BAD);
+    }
 
-    return 1;
+    return _cmd.handle;
 }
 
-char * ESP8266Class::searchBuffer(const char * test)
+// drive the command engine and the unsolicited result code dispatcher - call
+// this regularly from loop() when using the ...Async() functions
+void ESP8266Class::poll()
 {
-    int bufferLen = strlen((const char *)esp8266RxBuffer);
-    
-    // if our buffer isn't full, just do an strstr
-    if (bufferLen < ESP8266_RX_BUFFER_LEN)
+    // the passthrough session owns the uart - nothing we send can get a
+    // response until it has finished
+    if (_passthrough)
     {
-        return strstr((const char *)esp8266RxBuffer, test);
+        if (busy())
+        {
+            finishCommand(ESP8266_RSP_BUSY);
+        }
+        return;
     }
-    else
-    {    
-        //! TODO
-        // If the buffer is full, we need to search from the end of the 
-        // buffer back to the beginning.
-        int testLen = strlen(test);
-        for (int i = 0; i<ESP8266_RX_BUFFER_LEN; i++)
+
+    // background work only starts on a poll() that found the engine idle, so
+    // whoever was waiting on a command gets to read its response first
+    bool idle = !busy();
+
+    // only process what is already in the uart buffer so poll() stays cheap
+    int available = _serial->available();
+    while (available-- > 0)
+    {
+        // give unsolicited result codes first refusal on every byte (+IPD 
+        // frames are taken out of the stream completely)
+        char c = serialRead();
+        if (dispatchByte(c))
         {
+            continue;
+        }
+
+        // everything else is the response to the command we are waiting on
+        if (busy() && responseByte(c))
+        {
+            return;
+        }
+    }
+
+    // a buffered send waiting for the module to make room (as the SEND OKs
+    // come in) can carry on
+    if ((_cmd.state == ESP8266_CMD_WAIT_WINDOW) && (availableForWrite(_cmd.link) > 0))
+    {
+        startSegment();
+    }
 
+    // check for timeouts
+    if (busy() && (millis() - _cmd.start >= _cmd.timeout))
+    {
+        // if we've received some data we don't understand it
+        if (_cmd.received > 0)
+        {
+            finishCommand(ESP8266_RSP_UNKNOWN);
+        }
+        else
+        {
+            finishCommand(ESP8266_RSP_TIMEOUT);
         }
     }
+
+    // a tcpConnectMany() that had to wait for the engine goes first, then
+    // any client data that has been sitting around for long enough
+    if (idle && !busy() && connectingMany())
+    {
+        startNextTarget();
+    }
+    if (idle && !busy())
+    {
+        _sendBuffer.poll();
+    }
 }
 
+// add a byte to the response of the command we are waiting on - returns true
+// if this finished the command
+bool ESP8266Class::responseByte(char c)
+{
+    // nothing is expected while we wait for room to send
+    if (_cmd.state == ESP8266_CMD_WAIT_WINDOW)
+    {
+        return false;
+    }
+
+    // store it in the buffer and advance the matcher by one byte
+    storeByteInBuffer(c);
+    _cmd.received++;
+
+    // a response that is parsed as it arrives only ever needs the ring to
+    // hold the line it is on
+    if ((_cmd.line != NULL) && (c == '\n'))
+    {
+        (this->*_cmd.line)(linearizeBuffer());
+        clearBuffer();
+    }
+
+    int8_t match = _matcher.feed(c);
+    if (match == 0)
+    {
+        if (_cmd.state == ESP8266_CMD_WAIT_PROMPT)
+        {
+            // got the prompt, so send the segment (in one go) and wait for it
+            serialWrite(_cmd.payload + _cmd.payloadSent, _cmd.segmentLen);
+#ifdef ESP8266_STATS
+            _linkStats[_cmd.link].bytesSent += _cmd.segmentLen;
+            _linkStats[_cmd.link].segments++;
+            _segmentSent = millis();
+#endif
+
+            // buffered sends are done as soon as the module has the data -
+            // the SEND OK turns up later as <link ID>,<segment ID>,SEND OK
+            _matcher.reset();
+            if (_window[_cmd.link].mode == ESP8266_SEND_DIRECT)
+            {
+                _matcher.add(RESPONSE_SEND_OK);
+                _matcher.add(RESPONSE_SEND_FAIL);
+            }
+            else
+            {
+                _matcher.add(RESPONSE_RECV);
+            }
+            _matcher.add(RESPONSE_ERROR);
+            _cmd.state = ESP8266_CMD_WAIT_RESPONSE;
+            _cmd.start = millis();
+        }
+        else if ((_cmd.payload != NULL) && 
+                 (_cmd.payloadSent + _cmd.segmentLen < _cmd.payloadLen))
+        {
+            // segment sent - the firmware won't take the next AT+CIPSEND
+            // until it has said SEND OK, so send it the moment it does
+            if (_window[_cmd.link].mode == ESP8266_SEND_BUFFERED)
+            {
+                queueSegment();
+            }
+#ifdef ESP8266_STATS
+            else
+            {
+                linkRtt(_cmd.link, _segmentSent);
+            }
+#endif
+            _cmd.payloadSent += _cmd.segmentLen;
+            startSegment();
+        }
+        else
+        {
+            if (_cmd.payload != NULL)
+            {
+                if (_window[_cmd.link].mode == ESP8266_SEND_BUFFERED)
+                {
+                    queueSegment();
+                }
+#ifdef ESP8266_STATS
+                else
+                {
+                    linkRtt(_cmd.link, _segmentSent);
+                }
+#endif
+                _cmd.payloadSent += _cmd.segmentLen;
+            }
+            finishCommand(_cmd.received);
+            return true;
+        }
+    }
+    else if (match > 0)
+    {
+        finishCommand(ESP8266_RSP_FAIL);
+        return true;
+    }
+
+    return false;
+}
+
+// the command has finished - parse the response and tell whoever asked
+void ESP8266Class::finishCommand(int16_t rsp)
+{
+    if (_cmd.complete != NULL)
+    {
+        rsp = (this->*_cmd.complete)(rsp);
+    }
+
+#ifdef ESP8266_STATS
+    statsResult(rsp);
+#endif
+
+    // free the engine before the callback so it can start another command
+    _cmd.state = ESP8266_CMD_IDLE;
+    _cmd.result = rsp;
+    _cmd.payload = NULL;
+    _cmd.payloadLen = 0;
+    _results[_resultNext].handle = _cmd.handle;
+    _results[_resultNext].result = rsp;
+    _resultNext = (_resultNext + 1) % ESP8266_CMD_RESULTS;
+
+    // (either of these can start the next command)
+    esp8266_cmd_done done = _cmd.done;
+    _cmd.done = NULL;
+    if (_cmd.callback != NULL)
+    {
+        _cmd.callback(_cmd.handle, rsp);
+    }
+    if (done != NULL)
+    {
+        done(_cmd.context, rsp);
+    }
+}
+
+// let any command already in progress finish
+void ESP8266Class::waitForIdle()
+{
+    while (busy())
+    {
+        poll();
+    }
+}
+
+// block until the command completes and return its result - as soon as it
+// has one, as poll() can go straight on to background work (client data or
+// a tcpConnectMany() target) that we don't need to wait for
+int16_t ESP8266Class::waitForCommand(int16_t handle)
+{
+    if (handle < 0)
+    {
+        return handle;
+    }
+
+    int16_t rsp = commandResult(handle);
+    while (rsp == ESP8266_RSP_PENDING)
+    {
+        poll();
+        rsp = commandResult(handle);
+    }
+    return rsp;
+}
+
+// have the command tell whoever started it (rather than whichever esp8266 
+// they might guess at) when it has finished
+int16_t ESP8266Class::whenDone(int16_t handle, esp8266_cmd_done done, void * context)
+{
+    if (handle <= 0)
+    {
+        return handle;
+    }
+
+    if ((handle == _cmd.handle) && busy())
+    {
+        _cmd.done = done;
+        _cmd.context = context;
+    }
+    else
+    {
+        done(context, commandResult(handle));
+    }
+    return handle;
+}
+
+//////////////////////////////////////
+// Unsolicited Result Code Dispatch //
+//////////////////////////////////////
+
+// set the function called for connection and wifi events
+void ESP8266Class::setEventHandler(esp8266_event_callback handler)
+{
+    _urc.handler = handler;
+}
+
+// look at every byte coming from the esp8266 for unsolicited result codes - 
+// returns true if the byte was part of a +IPD frame (and so has been used up)
+bool ESP8266Class::dispatchByte(char c)
+{
+    switch (_urc.state)
+    {
+    case ESP8266_URC_IPD:
+        // the frame (header and payload) goes to the receive buffer, which
+        // knows how long it is
+        if (!_receiveBuffer.frameByte(c))
+        {
+            _urc.state = ESP8266_URC_LINE;
+        }
+        return true;
+
+    default:
+        if (c == '\n')
+        {
+            _urc.line[_urc.lineLen] = '\0';
+            dispatchLine();
+            _urc.lineLen = 0;
+        }
+        else if (c != '\r')
+        {
+            if (_urc.lineLen < ESP8266_URC_LINE_LEN - 1)
+            {
+                _urc.line[_urc.lineLen++] = c;
+            }
+
+            // +IPD frames don't end in a newline, so spot them early
+            if ((_urc.lineLen == 5) && (memcmp(_urc.line, "+IPD,", 5) == 0))
+            {
+                // "+IPD" has already gone into the response of any command
+                // we're waiting on, where it would look like the "+" of a
+                // result (e.g. AT+PING) - take it back, and keep the ","
+                if (busy() && (_cmd.state != ESP8266_CMD_WAIT_WINDOW))
+                {
+                    unstoreBytes(4);
+                }
+                _urc.state = ESP8266_URC_IPD;
+                _urc.lineLen = 0;
+                _receiveBuffer.beginFrame();
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+// classify a complete line from the esp8266
+void ESP8266Class::dispatchLine()
+{
+    const char * line = _urc.line;
+
+    // link events look like <link ID>,CONNECT
+    if ((line[0] >= '0') && (line[0] < '0' + ESP8266_MAX_SOCK_NUM) && (line[1] == ','))
+    {
+        uint8_t linkID = line[0] - '0';
+        if (strcmp(line + 2, "CONNECT") == 0)
+        {
+            raiseEvent(ESP8266_EVENT_CONNECT, linkID);
+        }
+        else if (strcmp(line + 2, "CLOSED") == 0)
+        {
+            raiseEvent(ESP8266_EVENT_CLOSED, linkID);
+        }
+        else if (strcmp(line + 2, "CONNECT FAIL") == 0)
+        {
+            raiseEvent(ESP8266_EVENT_CONNECT_FAIL, linkID);
+        }
+        else
+        {
+            // buffered sends finish with <link ID>,<segment ID>,SEND OK
+            char * end;
+            uint16_t segment = strtoul(line + 2, &end, 10);
+            if (end == line + 2)
+            {
+                return;
+            }
+            if (strcmp(end, ",SEND OK") == 0)
+            {
+                ackSegment(linkID, segment);
+                raiseEvent(ESP8266_EVENT_SEND_OK, linkID);
+            }
+            else if (strcmp(end, ",SEND FAIL") == 0)
+            {
+                ackSegment(linkID, segment);
+                raiseEvent(ESP8266_EVENT_SEND_FAIL, linkID);
+            }
+        }
+    }
+    else if (strcmp(line, "WIFI CONNECTED") == 0)
+    {
+        raiseEvent(ESP8266_EVENT_WIFI_CONNECTED, 0);
+    }
+    else if (strcmp(line, "WIFI GOT IP") == 0)
+    {
+        raiseEvent(ESP8266_EVENT_WIFI_GOT_IP, 0);
+    }
+    else if (strcmp(line, "WIFI DISCONNECT") == 0)
+    {
+        raiseEvent(ESP8266_EVENT_WIFI_DISCONNECT, 0);
+    }
+}
+
+// queue a connection event against its link, and tell the event handler
+void ESP8266Class::raiseEvent(esp8266_event event, uint8_t linkID)
+{
+    uint8_t mask = (1 << linkID);
+    switch (event)
+    {
+    case ESP8266_EVENT_CONNECT:
+        // only queue connections we didn't open ourselves
+        if (!(_urc.opening & mask))
+        {
+            queueAccept(linkID);
+        }
+        openLink(linkID, (_urc.opening & mask) ? ESP8266_CLIENT : ESP8266_SERVER);
+        // anything left over from the last connection on this link is stale
+        // (ESP8266UDP turns datagrams back on once it has the link)
+        _receiveBuffer.setDatagram(linkID, false);
+        _sendBuffer.takeError(linkID);
+        resetWindow(linkID);
+        _urc.opening &= ~mask;
+        _urc.closed &= ~mask;
+        break;
+    case ESP8266_EVENT_CLOSED:
+    case ESP8266_EVENT_CONNECT_FAIL:
+        _urc.closed |= mask;
+        dropAccept(linkID);
+        _urc.opening &= ~mask;
+        _window[linkID].mode = ESP8266_SEND_DIRECT;
+        resetWindow(linkID);
+        closeLink(linkID);
+        break;
+    case ESP8266_EVENT_WIFI_GOT_IP:
+        _status.stat = ESP8266_STATUS_GOTIP;
+        break;
+    case ESP8266_EVENT_WIFI_DISCONNECT:
+        _status.stat = ESP8266_STATUS_NOWIFI;
+        break;
+    default:
+        break;
+    }
+
+    if (_urc.handler != NULL)
+    {
+        _urc.handler(event, linkID);
+    }
+}
+
+// take the next queued CONNECT event (returns ESP8266_SOCK_NOT_AVAIL if none)
+uint8_t ESP8266Class::takeConnectEvent()
+{
+    if (_urc.acceptCount == 0)
+    {
+        return ESP8266_SOCK_NOT_AVAIL;
+    }
+
+    // first come, first served
+    uint8_t linkID = _urc.accept[_urc.acceptHead];
+    _urc.acceptHead = (_urc.acceptHead + 1) % ESP8266_MAX_SOCK_NUM;
+    _urc.acceptCount--;
+    _urc.connected &= ~(1 << linkID);
+    return linkID;
+}
+
+void ESP8266Class::queueAccept(uint8_t linkID)
+{
+    // there can't be more waiting than there are links, so this only fills
+    // up if the same link is queued twice
+    uint8_t mask = (1 << linkID);
+    if ((_urc.connected & mask) || (_urc.acceptCount >= ESP8266_MAX_SOCK_NUM))
+    {
+        return;
+    }
+
+    uint8_t tail = (_urc.acceptHead + _urc.acceptCount) % ESP8266_MAX_SOCK_NUM;
+    _urc.accept[tail] = linkID;
+    _urc.acceptCount++;
+    _urc.connected |= mask;
+}
+
+void ESP8266Class::dropAccept(uint8_t linkID)
+{
+    uint8_t mask = (1 << linkID);
+    if (!(_urc.connected & mask))
+    {
+        return;
+    }
+
+    // close up the gap, keeping everything else in order
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < _urc.acceptCount; i++)
+    {
+        uint8_t link = _urc.accept[(_urc.acceptHead + i) % ESP8266_MAX_SOCK_NUM];
+        if (link != linkID)
+        {
+            _urc.accept[(_urc.acceptHead + kept) % ESP8266_MAX_SOCK_NUM] = link;
+            kept++;
+        }
+    }
+    _urc.acceptCount = kept;
+    _urc.connected &= ~mask;
+}
+
+// take the queued CLOSED event for a link, if there is one
+bool ESP8266Class::takeCloseEvent(uint8_t linkID)
+{
+    uint8_t mask = (1 << linkID);
+    if (_urc.closed & mask)
+    {
+        _urc.closed &= ~mask;
+        return true;
+    }
+    return false;
+}
+
+//////////////////
+// Socket Table //
+//////////////////
+
+// a link has connected (either one we opened or one to our server)
+void ESP8266Class::openLink(uint8_t linkID, esp8266_tetype tetype)
+{
+    if (linkID >= ESP8266_MAX_SOCK_NUM)
+    {
+        return;
+    }
+
+    // the remote ip of a server link is only known after a resync
+    if (_status.ipstatus[linkID].linkID == ESP8266_SOCK_NOT_AVAIL)
+    {
+        _status.ipstatus[linkID].linkID = linkID;
+        _status.ipstatus[linkID].tetype = tetype;
+        if (tetype == ESP8266_SERVER)
+        {
+            _status.ipstatus[linkID].type = ESP8266_TCP;
+            _status.ipstatus[linkID].remoteIP = IPAddress(0, 0, 0, 0);
+            _status.ipstatus[linkID].port = 0;
+        }
+
+#ifdef ESP8266_STATS
+        // a new connection, so start its stats again
+        memset(&_linkStats[linkID], 0, sizeof(esp8266_link_stats));
+        _linkStats[linkID].open = true;
+        _linkStats[linkID].opened = millis();
+#endif
+    }
+    _state[linkID] = TAKEN;
+    _status.stat = ESP8266_STATUS_CONNECTED;
+}
+
+// a link has closed (or never managed to connect)
+void ESP8266Class::closeLink(uint8_t linkID)
+{
+    if (linkID >= ESP8266_MAX_SOCK_NUM)
+    {
+        return;
+    }
+
+#ifdef ESP8266_STATS
+    if (_linkStats[linkID].open)
+    {
+        _linkStats[linkID].open = false;
+        _linkStats[linkID].age = millis() - _linkStats[linkID].opened;
+    }
+#endif
+
+    _status.ipstatus[linkID].linkID = ESP8266_SOCK_NOT_AVAIL;
+    _state[linkID] = AVAILABLE;
+    _pool[linkID].keyed = false;
+    _pool[linkID].idle = false;
+    dropAccept(linkID);
+
+    // STATUS:4 once the last link has gone
+    if (_status.stat == ESP8266_STATUS_CONNECTED)
+    {
+        for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+        {
+            if (_status.ipstatus[i].linkID != ESP8266_SOCK_NOT_AVAIL)
+            {
+                return;
+            }
+        }
+        _status.stat = ESP8266_STATUS_DISCONNECTED;
+    }
+}
+
+/////////
+// DNS //
+/////////
+
+int16_t ESP8266Class::resolve(const char * host, IPAddress & ip)
+{
+    uint8_t entry = findHost(host);
+    if ((entry < ESP8266_DNS_CACHE_SIZE) && (millis() - _dns[entry].resolved < _dnsTTL))
+    {
+        ip = _dns[entry].ip;
+        return ESP8266_RSP_SUCCESS;
+    }
+
+    // send AT+CIPDOMAIN="host"
+    if (!sendFormatted("AT%s=\"%s\"\r\n", ESP8266_DNS_LOOKUP, host))
+    {
+        return ESP8266_CMD_BAD;
+    }
+
+    // Example good: +CIPDOMAIN:93.184.216.34\r\n\r\nOK\r\n
+    // Example bad:  DNS Fail\r\n\r\nERROR\r\n
+    int16_t rsp = readForResponses(RESPONSE_OK, RESPONSE_ERROR, COMMAND_DNS_TIMEOUT);
+    char * p = (rsp > 0) ? searchBuffer("+CIPDOMAIN:") : NULL;
+    if (p == NULL)
+    {
+        // an old answer is better than none
+        if (entry < ESP8266_DNS_CACHE_SIZE)
+        {
+            ip = _dns[entry].ip;
+            return ESP8266_RSP_SUCCESS;
+        }
+        return (rsp > 0) ? (int16_t)ESP8266_RSP_UNKNOWN : rsp;
+    }
+
+    // read the ip address octets
+    p += strlen("+CIPDOMAIN:");
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        size_t octetLength = strspn(p, "0123456789");
+        if ((octetLength == 0) || (octetLength >= 4))
+        {
+            return ESP8266_RSP_UNKNOWN;
+        }
+        ip[i] = atoi(p);
+        p += (octetLength + 1);
+    }
+
+    // reuse the host's entry, or replace the oldest one
+    if (entry >= ESP8266_DNS_CACHE_SIZE)
+    {
+        entry = 0;
+        for (uint8_t i = 0; i < ESP8266_DNS_CACHE_SIZE; i++)
+        {
+            if (!_dns[i].valid)
+            {
+                entry = i;
+                break;
+            }
+            if (millis() - _dns[i].resolved > millis() - _dns[entry].resolved)
+            {
+                entry = i;
+            }
+        }
+    }
+    _dns[entry].host = hostKey(host);
+    _dns[entry].ip = ip;
+    _dns[entry].resolved = millis();
+    _dns[entry].valid = true;
+
+    return ESP8266_RSP_SUCCESS;
+}
+
+void ESP8266Class::setDnsTTL(unsigned long ms)
+{
+    _dnsTTL = ms;
+}
+
+void ESP8266Class::flushDnsCache()
+{
+    for (uint8_t i = 0; i < ESP8266_DNS_CACHE_SIZE; i++)
+    {
+        _dns[i].valid = false;
+    }
+}
+
+uint8_t ESP8266Class::findHost(const char * host)
+{
+    esp8266_host_key key = hostKey(host);
+    for (uint8_t i = 0; i < ESP8266_DNS_CACHE_SIZE; i++)
+    {
+        if (_dns[i].valid && sameHost(_dns[i].host, key))
+        {
+            return i;
+        }
+    }
+    return ESP8266_DNS_CACHE_SIZE;
+}
+
+void ESP8266Class::forgetHost(const char * host)
+{
+    uint8_t entry = findHost(host);
+    if (entry < ESP8266_DNS_CACHE_SIZE)
+    {
+        _dns[entry].valid = false;
+    }
+}
+
+const char * ESP8266Class::cachedAddress(const char * host, char * address)
+{
+    if (isAddress(host))
+    {
+        return host;
+    }
+
+    uint8_t entry = findHost(host);
+    if ((entry >= ESP8266_DNS_CACHE_SIZE) || (millis() - _dns[entry].resolved >= _dnsTTL))
+    {
+        return host;
+    }
+
+    IPAddress & ip = _dns[entry].ip;
+    sprintf(address, "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
+    return address;
+}
+
+/////////////////////
+// Connection Pool //
+/////////////////////
+
+void ESP8266Class::setPoolSize(uint8_t size)
+{
+    _poolSize = size;
+}
+
+void ESP8266Class::setPoolTimeout(unsigned long ms)
+{
+    _poolTimeout = ms;
+}
+
+uint8_t ESP8266Class::takePooledLink(const char * host, uint16_t port)
+{
+    // pick up any pooled links that have been closed from the other end
+    poll();
+    expirePool();
+
+    esp8266_host_key key = hostKey(host);
+    for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+    {
+        if (_pool[i].idle && sameHost(_pool[i].host, key) && (_pool[i].port == port))
+        {
+            // anything the server sent while the link was idle isn't for
+            // the new client
+            _pool[i].idle = false;
+            _pool[i].lastUsed = millis();
+            _receiveBuffer.clear(i);
+            return i;
+        }
+    }
+    return ESP8266_SOCK_NOT_AVAIL;
+}
+
+void ESP8266Class::notePooledLink(uint8_t linkID, const char * host, uint16_t port)
+{
+    if (linkID >= ESP8266_MAX_SOCK_NUM)
+    {
+        return;
+    }
+
+    _pool[linkID].host = hostKey(host);
+    _pool[linkID].port = port;
+    _pool[linkID].lastUsed = millis();
+    _pool[linkID].keyed = true;
+    _pool[linkID].idle = false;
+}
+
+bool ESP8266Class::releaseLink(uint8_t linkID)
+{
+    if ((linkID >= ESP8266_MAX_SOCK_NUM) || (_poolSize == 0) || !_pool[linkID].keyed ||
+        (_status.ipstatus[linkID].linkID != linkID))
+    {
+        return false;
+    }
+
+    expirePool();
+
+    // make room by closing the link that has been idle longest
+    uint8_t idle = 0;
+    for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+    {
+        if (_pool[i].idle)
+        {
+            idle++;
+        }
+    }
+    if (idle >= _poolSize)
+    {
+        evictPooledLink();
+    }
+
+    _pool[linkID].idle = true;
+    _pool[linkID].lastUsed = millis();
+    return true;
+}
+
+uint8_t ESP8266Class::evictPooledLink()
+{
+    uint8_t oldest = ESP8266_SOCK_NOT_AVAIL;
+    unsigned long now = millis();
+    for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+    {
+        if (_pool[i].idle && ((oldest == ESP8266_SOCK_NOT_AVAIL) || 
+            (now - _pool[i].lastUsed > now - _pool[oldest].lastUsed)))
+        {
+            oldest = i;
+        }
+    }
+
+    if (oldest != ESP8266_SOCK_NOT_AVAIL)
+    {
+        close(oldest);
+        closeLink(oldest);
+    }
+    return oldest;
+}
+
+// close any pooled links that have been idle for too long
+void ESP8266Class::expirePool()
+{
+    unsigned long now = millis();
+    for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+    {
+        if (_pool[i].idle && (now - _pool[i].lastUsed >= _poolTimeout))
+        {
+            close(i);
+            closeLink(i);
+        }
+    }
+}
+
+//////////////////
+// Buffer Stuff //
+//////////////////
+void ESP8266Class::clearBuffer()
+{
+    // no need to wipe the storage, just forget what is in it
+    bufferHead = 0;
+    bufferCount = 0;
+    esp8266RxBuffer[0] = '\0';
+}
+
+void ESP8266Class::storeByteInBuffer(char c)
+{
+    // store the data in the buffer - if the buffer is full this overwrites the
+    // oldest byte, so keep count of how many bytes we have lost
+    esp8266RxBuffer[bufferHead] = c;
+    bufferHead = (bufferHead + 1) % ESP8266_RX_BUFFER_LEN;
+    if (bufferCount < ESP8266_RX_BUFFER_LEN)
+    {
+        bufferCount++;
+    }
+    else
+    {
+        bufferOverflow++;
+    }
+}
+
+void ESP8266Class::unstoreBytes(uint8_t count)
+{
+    if (count > bufferCount)
+    {
+        count = bufferCount;
+    }
+    bufferHead = (bufferHead + ESP8266_RX_BUFFER_LEN - count) % ESP8266_RX_BUFFER_LEN;
+    bufferCount -= count;
+    _cmd.received -= count;
+}
+
+// reverse the bytes in esp8266RxBuffer[start..end)
+static void reverseBuffer(unsigned int start, unsigned int end)
+{
+    while ((start + 1) < end)
+    {
+        end--;
+        char tmp = esp8266RxBuffer[start];
+        esp8266RxBuffer[start] = esp8266RxBuffer[end];
+        esp8266RxBuffer[end] = tmp;
+        start++;
+    }
+}
+
+char * ESP8266Class::linearizeBuffer()
+{
+    // once the ring has wrapped the oldest byte is bufferCount back from
+    // bufferHead (not always at bufferHead - unstoreBytes() can leave a 
+    // wrapped ring less than full) - rotate it in place (three reversals) so
+    // the oldest byte is back at index 0
+    unsigned int oldest = (bufferHead + ESP8266_RX_BUFFER_LEN - bufferCount) % ESP8266_RX_BUFFER_LEN;
+    if (oldest != 0)
+    {
+        reverseBuffer(0, oldest);
+        reverseBuffer(oldest, ESP8266_RX_BUFFER_LEN);
+        reverseBuffer(0, ESP8266_RX_BUFFER_LEN);
+    }
+    bufferHead = bufferCount % ESP8266_RX_BUFFER_LEN;
+
+    // null terminate so the string functions stop at the newest byte
+    esp8266RxBuffer[bufferCount] = '\0';
+
+    return esp8266RxBuffer;
+}
+
+char * ESP8266Class::searchBuffer(const char * test)
+{
+    // search the whole ring, including across the wrap point
+    return strstr(linearizeBuffer(), test);
+}
+
+unsigned long ESP8266Class::rxBufferOverflow()
+{
+    return bufferOverflow;
+}
+
+#ifdef ESP8266_TRACE
+ESP8266Trace & ESP8266Class::trace()
+{
+    return _trace;
+}
+#endif
+
+size_t ESP8266Class::serialWrite(const uint8_t * buf, size_t size)
+{
+#ifdef ESP8266_TRACE
+    _trace.record(ESP8266_TRACE_TX, buf, size);
+#endif
+#ifdef ESP8266_STATS
+    _stats.bytesOut += size;
+#endif
+    return _serial->write(buf, size);
+}
+
+int ESP8266Class::serialRead()
+{
+    int c = _serial->read();
+#ifdef ESP8266_TRACE
+    if (c >= 0)
+    {
+        _trace.record(ESP8266_TRACE_RX, (uint8_t)c);
+    }
+#endif
+#ifdef ESP8266_STATS
+    if (c >= 0)
+    {
+        _stats.bytesIn++;
+    }
+#endif
+    return c;
+}
+
+///////////////////
+// Command Stats //
+///////////////////
+
+#ifdef ESP8266_STATS
+
+// the command each kind starts with (in esp8266_stats_command order)
+static const char * const statsPrefix[ESP8266_STATS_COMMANDS] = {
+    ESP8266_TCP_CONNECT, ESP8266_TCP_SEND, ESP8266_TCP_CLOSE, ESP8266_TCP_STATUS,
+    ESP8266_PING, ESP8266_DNS_LOOKUP, "+CW", ""
+};
+
+static const char * const statsName[ESP8266_STATS_COMMANDS] = {
+    "CIPSTART", "CIPSEND", "CIPCLOSE", "CIPSTATUS", "PING", "CIPDOMAIN", "CW", "other"
+};
+
+void ESP8266Class::stats(esp8266_stats & snapshot)
+{
+    snapshot = _stats;
+    snapshot.rxOverflow = bufferOverflow;
+    snapshot.rxDropped = _receiveBuffer.dropped();
+}
+
+void ESP8266Class::printStats(Print & out)
+{
+    esp8266_stats snapshot;
+    stats(snapshot);
+
+    for (uint8_t i = 0; i < ESP8266_STATS_COMMANDS; i++)
+    {
+        const esp8266_command_stats & c = snapshot.command[i];
+        out.print(statsName[i]);
+        out.print(' ');
+        out.print(c.issued);
+        out.print(' ');
+        out.print(c.ok);
+        out.print(' ');
+        out.print(c.error);
+        out.print(' ');
+        out.print(c.timeout);
+        out.print(' ');
+        out.print(c.unknown);
+        out.print(' ');
+        out.print(c.maxLatency);
+        for (uint8_t j = 0; j < ESP8266_STATS_BUCKETS; j++)
+        {
+            out.print(' ');
+            out.print(c.latency[j]);
+        }
+        out.println();
+    }
+
+    out.print("bytes ");
+    out.print(snapshot.bytesOut);
+    out.print(' ');
+    out.print(snapshot.bytesIn);
+    out.print(' ');
+    out.print(snapshot.rxOverflow);
+    out.print(' ');
+    out.println(snapshot.rxDropped);
+
+    // link <id> <open> <age> <sent> <received> <dropped> <high water>
+    //      <segments> <acked> <last rtt> <max rtt> <total rtt>
+    esp8266_link_stats links[ESP8266_MAX_SOCK_NUM];
+    linkStats(links);
+    for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+    {
+        const esp8266_link_stats & l = links[i];
+        unsigned long values[] = { l.open, l.age, l.bytesSent, l.bytesReceived,
+                                   l.rxDropped, l.rxHighWater, l.segments, l.acked,
+                                   l.lastRtt, l.maxRtt, l.totalRtt };
+        out.print("link ");
+        out.print(i);
+        for (uint8_t j = 0; j < sizeof(values) / sizeof(values[0]); j++)
+        {
+            out.print(' ');
+            out.print(values[j]);
+        }
+        out.println();
+    }
+}
+
+void ESP8266Class::clearStats()
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void ESP8266Class::linkStats(esp8266_link_stats * snapshot)
+{
+    for (uint8_t i = 0; i < ESP8266_MAX_SOCK_NUM; i++)
+    {
+        snapshot[i] = _linkStats[i];
+        if (snapshot[i].open)
+        {
+            snapshot[i].age = millis() - snapshot[i].opened;
+        }
+    }
+}
+
+void ESP8266Class::linkRtt(uint8_t linkID, unsigned long sent)
+{
+    esp8266_link_stats & link = _linkStats[linkID];
+    unsigned long rtt = millis() - sent;
+    link.lastRtt = (rtt > 0xFFFF) ? 0xFFFF : rtt;
+    link.maxRtt = max(link.maxRtt, link.lastRtt);
+    link.totalRtt += rtt;
+    link.acked++;
+}
+
+uint8_t ESP8266Class::statsCommand(const char * line)
+{
+    // (AT+CIPSENDBUF counts as AT+CIPSEND, and the last prefix matches
+    // anything)
+    uint8_t i = 0;
+    while (strncmp(line, statsPrefix[i], strlen(statsPrefix[i])) != 0)
+    {
+        i++;
+    }
+    return i;
+}
+
+void ESP8266Class::statsResult(int16_t rsp)
+{
+    esp8266_command_stats & c = _stats.command[_statsCommand];
+    if (rsp >= 0)
+    {
+        c.ok++;
+    }
+    else if (rsp == ESP8266_RSP_TIMEOUT)
+    {
+        c.timeout++;
+    }
+    else if (rsp == ESP8266_RSP_UNKNOWN)
+    {
+        c.unknown++;
+    }
+    else
+    {
+        c.error++;
+    }
+
+    unsigned long ms = (micros() - _statsStart) / 1000;
+    if (ms > c.maxLatency)
+    {
+        c.maxLatency = (ms > 0xFFFF) ? 0xFFFF : ms;
+    }
+
+    // bucket n is everything under 2^n ms
+    uint8_t bucket = 0;
+    while ((ms > 0) && (bucket < ESP8266_STATS_BUCKETS - 1))
+    {
+        ms >>= 1;
+        bucket++;
+    }
+    c.latency[bucket]++;
+}
+
+#endif
+
 ESP8266Class esp8266;
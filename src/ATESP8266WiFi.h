@@ -24,9 +24,14 @@ Distributed as-is; no warranty is given.
 #include <Arduino.h>
 #include <SoftwareSerial.h>
 #include <IPAddress.h>
+#include <stdarg.h>
 
 #include "ATESP8266Client.h"
 #include "ATESP8266Server.h"
+#include "ATESP8266Passthrough.h"
+#include "ATESP8266UDP.h"
+#include "ATESP8266ResponseMatcher.h"
+#include "ATESP8266Trace.h"
 
 /////////////////////
 // Pin Definitions //
@@ -42,13 +47,103 @@ Distributed as-is; no warranty is given.
 #define WIFI_CONNECT_TIMEOUT        30000
 #define COMMAND_RESET_TIMEOUT       5000
 #define CLIENT_CONNECT_TIMEOUT      5000
+#define COMMAND_DNS_TIMEOUT         5000
+
+// the "+++" that ends passthrough mode only counts if nothing else is sent for
+// this long (in ms) either side of it
+#ifndef ESP8266_PASSTHROUGH_GUARD
+#define ESP8266_PASSTHROUGH_GUARD   1000
+#endif
+
+// how many links can be kept open for reuse after their client stops (0 
+// closes them straight away), and how long (in ms) they are kept
+#ifndef ESP8266_POOL_SIZE
+#define ESP8266_POOL_SIZE           0
+#endif
+#ifndef ESP8266_POOL_TIMEOUT
+#define ESP8266_POOL_TIMEOUT        30000
+#endif
+
+// host names resolved with AT+CIPDOMAIN are remembered (in a table this big)
+// for this long (in ms), so connects can go straight to the ip address
+#ifndef ESP8266_DNS_CACHE_SIZE
+#if defined(__AVR__)
+#define ESP8266_DNS_CACHE_SIZE      2
+#else
+#define ESP8266_DNS_CACHE_SIZE      8
+#endif
+#endif
+#ifndef ESP8266_DNS_TTL
+#define ESP8266_DNS_TTL             300000
+#endif
+
+// define ESP8266_TRACE (for the whole build) to keep a record of the uart
+// traffic in esp8266.trace() - see ATESP8266Trace.h
+
+// define ESP8266_STATS (for the whole build) to count the commands sent, how
+// they went and how long they took (see stats()) - the latencies go in 
+// buckets of <1ms, <2ms, <4ms ... with the last one taking everything longer
+#ifndef ESP8266_STATS_BUCKETS
+#if defined(__AVR__)
+#define ESP8266_STATS_BUCKETS       12
+#else
+#define ESP8266_STATS_BUCKETS       16
+#endif
+#endif
+
+////////////////////////
+// Buffer Definitions //
+////////////////////////
+// the command response buffer is a ring - define ESP8266_RX_BUFFER_LEN before
+// including this library to change its size
+#ifndef ESP8266_RX_BUFFER_LEN
+#define ESP8266_RX_BUFFER_LEN       128
+#endif
+
+// longest unsolicited result code line we need to recognise
+#define ESP8266_URC_LINE_LEN        24
+
+// commandResult() remembers the results of this many finished commands, so a
+// result can still be read once the engine has moved on to the next one
+#ifndef ESP8266_CMD_RESULTS
+#define ESP8266_CMD_RESULTS         4
+#endif
+
+// commands are formatted into a staging buffer this long so they can be sent
+// with a single write (the longest is AT+CWJAP_DEF with a 32 character ssid
+// and 64 character password)
+#ifndef ESP8266_TX_BUFFER_LEN
+#define ESP8266_TX_BUFFER_LEN       128
+#endif
+
+// payloads bigger than this are sent as several AT+CIPSENDs (the firmware
+// limit is 2048, 1460 is a full TCP segment)
+#ifndef ESP8266_TCP_SEGMENT_SIZE
+#define ESP8266_TCP_SEGMENT_SIZE    1460
+#endif
+
+// with buffered sends (AT+CIPSENDBUF) the module keeps each link's data until
+// the other end acks it - this is how much we let it hold (the firmware's TCP
+// send window is 2 full segments) and how many segments we keep track of
+#ifndef ESP8266_SEND_WINDOW
+#define ESP8266_SEND_WINDOW         2920
+#endif
+#ifndef ESP8266_SEND_QUEUE_LEN
+#define ESP8266_SEND_QUEUE_LEN      4
+#endif
 
 #define ESP8266_MAX_SOCK_NUM        5
 #define ESP8266_SOCK_NOT_AVAIL      255
 
+// the receive and transmit buffers need to know how many links there are
+#include "ATESP8266ClientReadBuffer.h"
+#include "ATESP8266ClientWriteBuffer.h"
+
 static SoftwareSerial swSerial(ESP8266_SW_TX, ESP8266_SW_RX);
 
 typedef enum esp8266_cmd_rsp {
+	ESP8266_RSP_PENDING = -7,
+	ESP8266_RSP_BUSY = -6,
 	ESP8266_CMD_BAD = -5,
 	ESP8266_RSP_MEMORY_ERR = -4,
 	ESP8266_RSP_FAIL = -3,
@@ -69,6 +164,34 @@ typedef enum esp8266_command_type {
 	ESP8266_CMD_EXECUTE
 };
 
+enum esp8266_cmd_state {
+	ESP8266_CMD_IDLE,
+	ESP8266_CMD_WAIT_WINDOW,
+	ESP8266_CMD_WAIT_PROMPT,
+	ESP8266_CMD_WAIT_RESPONSE
+};
+
+enum esp8266_urc_state {
+	ESP8266_URC_LINE,
+	ESP8266_URC_IPD
+};
+
+enum esp8266_event {
+	ESP8266_EVENT_CONNECT,
+	ESP8266_EVENT_CLOSED,
+	ESP8266_EVENT_CONNECT_FAIL,
+	ESP8266_EVENT_WIFI_CONNECTED,
+	ESP8266_EVENT_WIFI_GOT_IP,
+	ESP8266_EVENT_WIFI_DISCONNECT,
+	ESP8266_EVENT_SEND_OK,
+	ESP8266_EVENT_SEND_FAIL
+};
+
+enum esp8266_send_mode {
+	ESP8266_SEND_DIRECT,
+	ESP8266_SEND_BUFFERED
+};
+
 typedef enum esp8266_encryption {
 	ESP8266_ECN_OPEN,
 	ESP8266_ECN_WPA_PSK,
@@ -119,6 +242,102 @@ struct esp8266_status
 	esp8266_ipstatus ipstatus[ESP8266_MAX_SOCK_NUM];
 };
 
+// one of the connections for tcpConnectMany() - linkID can be 
+// ESP8266_SOCK_NOT_AVAIL to use any free link (it is filled in), and result is
+// what tcpConnect() would have returned (ESP8266_CMD_BAD if linkID is one
+// that is already taken)
+struct esp8266_connect_target
+{
+	uint8_t linkID;
+	const char * host;
+	uint16_t port;
+	uint16_t keepAlive;
+	int16_t result;
+};
+
+// the kinds of command the stats are kept for
+enum esp8266_stats_command {
+	ESP8266_STATS_CONNECT,		// AT+CIPSTART
+	ESP8266_STATS_SEND,			// AT+CIPSEND / AT+CIPSENDBUF and the payload
+	ESP8266_STATS_CLOSE,		// AT+CIPCLOSE
+	ESP8266_STATS_STATUS,		// AT+CIPSTATUS
+	ESP8266_STATS_PING,			// AT+PING
+	ESP8266_STATS_DNS,			// AT+CIPDOMAIN
+	ESP8266_STATS_WIFI,			// AT+CW...
+	ESP8266_STATS_OTHER,
+	ESP8266_STATS_COMMANDS
+};
+
+// how the commands of one kind have gone (the counts wrap round) - latency
+// is from the command being sent to the end of its response, and
+// latency[n] counts the ones that took less than 2^n ms
+struct esp8266_command_stats
+{
+	uint16_t issued;
+	uint16_t ok;
+	uint16_t error;
+	uint16_t timeout;
+	uint16_t unknown;
+	uint16_t maxLatency;
+	uint16_t latency[ESP8266_STATS_BUCKETS];
+};
+
+struct esp8266_stats
+{
+	esp8266_command_stats command[ESP8266_STATS_COMMANDS];
+	unsigned long bytesOut;
+	unsigned long bytesIn;
+	unsigned long rxOverflow;	// response bytes lost (see rxBufferOverflow())
+	unsigned long rxDropped;	// +IPD payload bytes lost to full client buffers
+};
+
+// how the traffic on one link has gone since it last opened (kept until it
+// opens again) - rtt is from a segment going to the module to its SEND OK
+struct esp8266_link_stats
+{
+	bool open;
+	unsigned long age;			// ms it has been (or was) open
+	unsigned long opened;		// millis() when it opened
+	unsigned long bytesSent;
+	unsigned long bytesReceived;	// +IPD payload, including anything dropped
+	unsigned long rxDropped;
+	uint16_t rxHighWater;		// most payload waiting to be read at once
+	uint16_t segments;
+	uint16_t acked;
+	uint16_t lastRtt;
+	uint16_t maxRtt;
+	unsigned long totalRtt;		// (over [acked] segments, for the average)
+};
+
+// what the pool (and the dns cache) know a host name by - two different
+// hashes and the length, so names that aren't the same don't match without
+// keeping a copy of each one
+struct esp8266_host_key
+{
+	uint32_t fnv;
+	uint32_t djb;
+	uint8_t length;
+};
+
+class ESP8266Class;
+
+// called when a command started with one of the ...Async() functions finishes
+typedef void (*esp8266_cmd_callback)(int16_t handle, int16_t result);
+
+// called when a command the library started for itself finishes, with the
+// context it was started with (the object to carry on with)
+typedef void (*esp8266_cmd_done)(void * context, int16_t result);
+
+// called for connection and wifi events (linkID is 0 for wifi events)
+typedef void (*esp8266_event_callback)(esp8266_event event, uint8_t linkID);
+
+// parses the response to a command once it has finished
+typedef int16_t (ESP8266Class::*esp8266_cmd_complete)(int16_t rsp);
+
+// parses each line of a response as it arrives (for responses that can be
+// longer than the ring)
+typedef void (ESP8266Class::*esp8266_cmd_line)(char * line);
+
 class ESP8266Class : public Stream
 {
 
@@ -128,6 +347,11 @@ public:
 
 	bool begin(unsigned long baudRate = 9600, esp8266_serial_port serialPort = ESP8266_SOFTWARE_SERIAL);
 
+	/// begin([baudRate], [serialPort], [hosts], [count]) - As above, then
+	/// look up the [count] host names in [hosts] so the first connect to
+	/// each doesn't have to (hosts that can't be resolved yet are skipped)
+	bool begin(unsigned long baudRate, esp8266_serial_port serialPort, const char * const hosts[], uint8_t count);
+
 	///////////////////////
 	// Basic AT Commands //
 	///////////////////////
@@ -155,15 +379,102 @@ public:
 	/////////////////////
 	int16_t status();
 	int16_t updateStatus();
+
+	/// tcpConnect([linkID], [destination], [port], [keepAlive]) - Open a tcp
+	/// connection, looking a host name up with resolve() first
+	/// Success: >0
+	/// Fail: <0 (esp8266_cmd_rsp), including resolve()'s if the lookup fails
 	int16_t tcpConnect(uint8_t linkID, const char * destination, uint16_t port, uint16_t keepAlive);
 	int16_t tcpSend(uint8_t linkID, const uint8_t *buf, size_t size);
+	int16_t udpConnect(uint8_t linkID, const char * destination, uint16_t port, uint16_t localPort, uint8_t mode = 2);
+	int16_t udpSend(uint8_t linkID, const uint8_t *buf, size_t size, const char * destination, uint16_t port);
+	int16_t setDataInfo(bool enable);
 	int16_t close(uint8_t linkID);
 	int16_t setTransferMode(uint8_t mode);
 	int16_t setMux(bool enable);
 	int16_t configureTCPServer(uint16_t port, uint8_t create = 1);
+
+	/// setSendMode([linkID], [mode]) - Send the link's data with AT+CIPSEND
+	/// (waiting for every SEND OK) or AT+CIPSENDBUF (several segments can be
+	/// waiting for their SEND OK at once)
+	int16_t setSendMode(uint8_t linkID, esp8266_send_mode mode);
+
+	/// availableForWrite([linkID]) - Bytes the module can take for the link
+	/// without waiting for any acks
+	int availableForWrite(uint8_t linkID);
+
+	/// updateSendStatus([linkID]) - Check our count of buffered segments
+	/// against the module's (AT+CIPBUFSTATUS)
+	/// Success: Returns the free space in the module's buffer
+	/// Fail: <0 (esp8266_cmd_rsp)
+	int16_t updateSendStatus(uint8_t linkID);
+	/// ping([ip]), ping([server]) - Ping a host (AT+PING)
+	/// Success: Returns the round trip time in ms
+	/// Fail: <0 (esp8266_cmd_rsp), ESP8266_RSP_TIMEOUT if no reply came
 	int16_t ping(IPAddress ip);
 	int16_t ping(char * server);
 
+	/// tcpConnectMany([targets], [count]) - Open several connections, each
+	/// AT+CIPSTART going out as soon as the last one has finished
+	/// Returns the number of connections made (see each target's result)
+	int16_t tcpConnectMany(esp8266_connect_target targets[], uint8_t count);
+
+	///////////////////////////
+	// Asynchronous Commands //
+	///////////////////////////
+	// these return a handle (>0) straight away, or ESP8266_RSP_BUSY if another
+	// command is in progress. call poll() from loop() to drive them, then get
+	// the result from the callback or from commandResult(handle)
+	int16_t connectAsync(const char * ssid, const char * pwd, esp8266_cmd_callback callback = NULL);
+	int16_t updateStatusAsync(esp8266_cmd_callback callback = NULL);
+	int16_t tcpConnectAsync(uint8_t linkID, const char * destination, uint16_t port, uint16_t keepAlive, esp8266_cmd_callback callback = NULL);
+	int16_t tcpSendAsync(uint8_t linkID, const uint8_t *buf, size_t size, esp8266_cmd_callback callback = NULL);
+	int16_t pingAsync(char * server, esp8266_cmd_callback callback = NULL);
+
+	/// tcpConnectManyAsync([targets], [count], [callback]) - As above in 
+	/// the background ([targets] must stay valid). If another command is in
+	/// progress the first AT+CIPSTART waits for it. Returns 
+	/// ESP8266_RSP_SUCCESS once started (ESP8266_RSP_BUSY if another 
+	/// tcpConnectMany() is still going), and calls [callback] with a handle
+	/// of 0 and the number of connections made when they are all done.
+	int16_t tcpConnectManyAsync(esp8266_connect_target targets[], uint8_t count, esp8266_cmd_callback callback = NULL);
+	bool connectingMany();
+	void poll();
+	bool busy();
+	int16_t commandResult(int16_t handle);
+
+	/// setEventHandler([handler]) - Call [handler] for each CONNECT, CLOSED
+	/// or WIFI event, even if it arrives while a command is in progress
+	void setEventHandler(esp8266_event_callback handler);
+
+	/////////
+	// DNS //
+	/////////
+	/// resolve([host], [ip]) - Look up [host] (AT+CIPDOMAIN), using the
+	/// cache if we have looked it up recently. If the lookup fails, an
+	/// expired cache entry is used instead.
+	/// Success: Returns ESP8266_RSP_SUCCESS and sets [ip]
+	/// Fail: <0 (esp8266_cmd_rsp)
+	int16_t resolve(const char * host, IPAddress & ip);
+
+	/// setDnsTTL([ms]) - How long resolved addresses are kept
+	void setDnsTTL(unsigned long ms);
+
+	/// flushDnsCache() - Forget every resolved address
+	void flushDnsCache();
+
+	/////////////////////
+	// Connection Pool //
+	/////////////////////
+	/// setPoolSize([size]) - Keep up to [size] links open when their client
+	/// stops, and hand them back to the next connect() to the same host and
+	/// port (0 turns pooling off)
+	void setPoolSize(uint8_t size);
+
+	/// setPoolTimeout([ms]) - Close pooled links that have been idle for
+	/// this long (checked on the next connect() or stop())
+	void setPoolTimeout(unsigned long ms);
+
 	//int16_t tcpConnectSSL(uint8_t linkID, const char * destination, uint16_t port, uint16_t keepAlive);
 	//int16_t setSSLbuffer(uint16_t buffSize);
 	
@@ -171,14 +482,56 @@ public:
 	// Virtual Functions from Stream //
 	///////////////////////////////////
 	size_t write(uint8_t);
+	size_t write(const uint8_t *buf, size_t size);
 	int available();
 	int read();
 	int peek();
 	void flush();
+
+	using Print::write;
+
+	/// passthrough() - True while a passthrough session has the uart (no AT
+	/// commands can be sent until it ends)
+	bool passthrough();
+
+	/// rxBufferOverflow() - Number of response bytes that have been
+	/// overwritten because the receive ring was full
+	unsigned long rxBufferOverflow();
+
+#ifdef ESP8266_TRACE
+	/// trace() - The record of everything sent to and read from the module
+	ESP8266Trace & trace();
+#endif
+
+#ifdef ESP8266_STATS
+	/// stats([snapshot]) - Copy the command stats and byte counts into 
+	/// [snapshot]
+	void stats(esp8266_stats & snapshot);
+
+	/// printStats([out]) - Write the stats to [out] as text, one line per
+	/// kind of command:
+	/// <name> <issued> <ok> <error> <timeout> <unknown> <max ms> <buckets...>
+	/// then "bytes <out> <in> <overflow> <dropped>" and a "link <id> ..."
+	/// line with the linkStats() of each link
+	void printStats(Print & out);
+
+	/// clearStats() - Start counting again from zero (the link stats are
+	/// kept)
+	void clearStats();
+
+	/// linkStats([snapshot]) - Copy the stats for every link into
+	/// [snapshot] (which needs room for ESP8266_MAX_SOCK_NUM). This is
+	/// kept up to date as data comes and goes, so no AT command is sent.
+	void linkStats(esp8266_link_stats * snapshot);
+#endif
 	
 	friend class ESP8266Client;
 	friend class ESP8266ClientReadBuffer;
+	friend class ESP8266ClientWriteBuffer;
 	friend class ESP8266Server;
+	friend class ESP8266Passthrough;
+	friend class ESP8266UDP;
+	friend class ESP8266TraceReplay;
 
 	int16_t _state[ESP8266_MAX_SOCK_NUM];
 
@@ -190,26 +543,291 @@ private:
 	//////////////////////////
 	// Command Send/Receive //
 	//////////////////////////
+	// all the uart traffic goes through these (so it can be traced)
+	size_t serialWrite(const uint8_t * buf, size_t size);
+	int serialRead();
+
 	void sendCommand(const char * cmd, enum esp8266_command_type type = ESP8266_CMD_EXECUTE, const char * params = NULL);
+	bool sendFormatted(const char * format, ...);
+	bool writeFormatted(const char * format, ...);
+	bool vwriteFormatted(const char * format, va_list args);
 	int16_t readForResponse(const char * rsp, unsigned int timeout);
 	int16_t readForResponses(const char * pass, const char * fail, unsigned int timeout);
 
+	/// _matcher - Incremental matcher for the responses we are waiting for
+	ESP8266ResponseMatcher _matcher;
+
+	////////////////////
+	// Command Engine //
+	////////////////////
+	/// startCommand([timeout], [complete], [callback]) - Start waiting for
+	/// the response to the command just sent. Returns the command handle
+	/// (if _matcher turned one of the responses away the command has
+	/// already failed with ESP8266_CMD_BAD).
+	int16_t startCommand(unsigned int timeout, esp8266_cmd_complete complete = NULL, esp8266_cmd_callback callback = NULL);
+	bool responseByte(char c);
+	void finishCommand(int16_t rsp);
+	void waitForIdle();
+	int16_t waitForCommand(int16_t handle);
+
+	/// whenDone([handle], [done], [context]) - Call [done] with [context]
+	/// once the command [handle] has finished (straight away if it already
+	/// has). Returns [handle].
+	int16_t whenDone(int16_t handle, esp8266_cmd_done done, void * context);
+
+	/// complete...([rsp]) - Parse the response once the command has finished
+	int16_t completeStatus(int16_t rsp);
+
+	/// statusLine([line]) - Parse a line of the AT+CIPSTATUS response into
+	/// the _status table
+	void statusLine(char * line);
+
+	// the links the AT+CIPSTATUS in progress has listed so far, whether its
+	// STATUS: line has arrived, and how many bytes the ring had lost when it
+	// started (a line too long for the ring means the list can't be trusted)
+	uint8_t _statusListed;
+	bool _statusHeader;
+	unsigned long _statusOverflow;
+	int16_t startConnect(uint8_t linkID, esp8266_connection_type type, uint16_t port, esp8266_cmd_callback callback);
+	int16_t completeTcpConnect(int16_t rsp);
+	void startNextTarget();
+	static void targetComplete(void * context, int16_t result);
+
+	// the tcpConnectMany() in progress
+	struct esp8266_connect_batch
+	{
+		esp8266_connect_target * targets;
+		uint8_t count;
+		uint8_t next;
+		uint8_t connected;
+		uint8_t claimed;	// bit per link taken for the batch
+		esp8266_cmd_callback callback;
+	} _batch;
+	int16_t completeTcpSend(int16_t rsp);
+	void startSegment();
+	int16_t completePing(int16_t rsp);
+	int16_t completeSendStatus(int16_t rsp);
+
+	struct esp8266_command
+	{
+		esp8266_cmd_state state;
+		int16_t handle;
+		int16_t result;
+		unsigned long start;
+		unsigned int timeout;
+		unsigned int received;
+		uint8_t link;
+		const uint8_t * payload;
+		size_t payloadLen;
+		size_t payloadSent;
+		size_t segmentLen;
+		const char * remote;
+		uint16_t remotePort;
+		esp8266_cmd_complete complete;
+		esp8266_cmd_line line;
+		esp8266_cmd_callback callback;
+		esp8266_cmd_done done;
+		void * context;
+	} _cmd;
+
+	// the results of the last few commands to finish (the oldest is
+	// overwritten next)
+	struct esp8266_cmd_result
+	{
+		int16_t handle;
+		int16_t result;
+	} _results[ESP8266_CMD_RESULTS];
+	uint8_t _resultNext;
+
 	//////////////////
 	// Buffer Stuff // 
 	//////////////////
-	/// clearBuffer() - Reset buffer pointer, set all values to 0
+	/// clearBuffer() - Reset buffer pointers (the contents are left alone)
 	void clearBuffer();
 
-	/// readByteToBuffer() - Read first byte from UART receive buffer
-	/// and store it in rxBuffer.
-	unsigned int readByteToBuffer();
+	/// storeByteInBuffer([c]) - Store a byte of the command response in 
+	/// rxBuffer
+	void storeByteInBuffer(char c);
+
+	/// unstoreBytes([count]) - Take back the last [count] bytes stored
+	void unstoreBytes(uint8_t count);
 
-	/// searchBuffer([test]) - Search buffer for string [test]
+	/// linearizeBuffer() - Rotate the ring so the oldest byte is first and
+	/// null terminate it. Returns a pointer to the start of the buffer.
+	char * linearizeBuffer();
+
+	/// searchBuffer([test]) - Search buffer for string [test], including
+	/// across the point where the ring wraps
 	/// Success: Returns pointer to beginning of string
 	/// Fail: returns NULL
-	//! TODO: Fix this function so it searches circularly
 	char * searchBuffer(const char * test);
 
+	//////////////////////////////////////
+	// Unsolicited Result Code Dispatch //
+	//////////////////////////////////////
+	/// dispatchByte([c]) - Feed a received byte to the URC dispatcher.
+	/// Returns true if the byte belonged to a +IPD frame.
+	bool dispatchByte(char c);
+	void dispatchLine();
+	void raiseEvent(esp8266_event event, uint8_t linkID);
+
+	/// takeConnectEvent() - Link ID of the oldest connection to our server
+	/// that hasn't been accepted yet, or ESP8266_SOCK_NOT_AVAIL if there
+	/// isn't one
+	uint8_t takeConnectEvent();
+	bool takeCloseEvent(uint8_t linkID);
+
+	/// queueAccept([linkID]) / dropAccept([linkID]) - Add a new connection
+	/// to the accept queue, or take it out again if it closes first
+	void queueAccept(uint8_t linkID);
+	void dropAccept(uint8_t linkID);
+
+	struct esp8266_urc
+	{
+		esp8266_urc_state state;
+		char line[ESP8266_URC_LINE_LEN];
+		uint8_t lineLen;
+		// accept queue (in the order the connections arrived) - connected
+		// is the set of links in it
+		uint8_t accept[ESP8266_MAX_SOCK_NUM];
+		uint8_t acceptHead;
+		uint8_t acceptCount;
+		uint8_t connected;
+		uint8_t closed;
+		uint8_t opening;
+		esp8266_event_callback handler;
+	} _urc;
+
+	/// _receiveBuffer - Payload from +IPD frames, split up by link
+	ESP8266ClientReadBuffer _receiveBuffer;
+
+	/// _sendBuffer - Data written by clients, waiting to be sent
+	ESP8266ClientWriteBuffer _sendBuffer;
+
+	//////////////////////
+	// Buffered Sending //
+	//////////////////////
+	/// queueSegment() - Note the segment the module has just taken, so we
+	/// can match up its SEND OK
+	void queueSegment();
+
+	/// ackSegment([linkID], [segment]) - Forget every segment up to and
+	/// including [segment]
+	void ackSegment(uint8_t linkID, uint16_t segment);
+	void resetWindow(uint8_t linkID);
+
+	// segments the module is holding for each link (oldest first)
+	struct esp8266_send_window
+	{
+		esp8266_send_mode mode;
+		uint16_t nextSegment;
+		uint16_t inflight;
+		uint8_t head;
+		uint8_t queued;
+		uint16_t segment[ESP8266_SEND_QUEUE_LEN];
+		uint16_t length[ESP8266_SEND_QUEUE_LEN];
+#ifdef ESP8266_STATS
+		unsigned long sent[ESP8266_SEND_QUEUE_LEN];
+#endif
+	} _window[ESP8266_MAX_SOCK_NUM];
+
+	/////////////////
+	// Passthrough //
+	/////////////////
+	/// startPassthrough([destination], [port], [keepAlive]) - Connect as the
+	/// only link and start streaming (AT+CIPMODE=1 then AT+CIPSEND)
+	int16_t startPassthrough(const char * destination, uint16_t port, uint16_t keepAlive);
+
+	/// stopPassthrough() - Send "+++", close the link and go back to
+	/// multiple connections
+	int16_t stopPassthrough();
+
+	bool _passthrough;
+
+	//////////////////
+	// Socket Table //
+	//////////////////
+	/// openLink([linkID], [tetype]) / closeLink([linkID]) - Keep _state and
+	/// _status up to date as links come and go, so finding a free socket or
+	/// checking a connection doesn't need an AT+CIPSTATUS
+	void openLink(uint8_t linkID, esp8266_tetype tetype);
+	void closeLink(uint8_t linkID);
+
+	/////////
+	// DNS //
+	/////////
+	/// findHost([host]) - Index of [host] in the cache (fresh or not), or
+	/// ESP8266_DNS_CACHE_SIZE if it isn't there
+	uint8_t findHost(const char * host);
+	void forgetHost(const char * host);
+
+	/// cachedAddress([host], [address]) - Write the cached ip address for
+	/// [host] into [address] and return it, or return [host] if we don't
+	/// have a fresh one
+	const char * cachedAddress(const char * host, char * address);
+
+	struct esp8266_dns_entry
+	{
+		esp8266_host_key host;
+		IPAddress ip;
+		unsigned long resolved;
+		bool valid;
+	} _dns[ESP8266_DNS_CACHE_SIZE];
+	unsigned long _dnsTTL;
+
+	/////////////////////
+	// Connection Pool //
+	/////////////////////
+	/// takePooledLink([host], [port]) - An idle link that is still connected
+	/// to host:port, or ESP8266_SOCK_NOT_AVAIL
+	uint8_t takePooledLink(const char * host, uint16_t port);
+
+	/// notePooledLink([linkID], [host], [port]) - Remember where a link we
+	/// have just opened goes
+	void notePooledLink(uint8_t linkID, const char * host, uint16_t port);
+
+	/// releaseLink([linkID]) - Keep the link open in the pool
+	/// Returns false if it should be closed instead
+	bool releaseLink(uint8_t linkID);
+
+	/// evictPooledLink() - Close the least recently used idle link
+	/// Returns the link that was closed, or ESP8266_SOCK_NOT_AVAIL
+	uint8_t evictPooledLink();
+	void expirePool();
+
+	// links are matched on a key made from the host name (so the pool costs
+	// a few bytes per link rather than a copy of the name)
+	struct esp8266_pool_entry
+	{
+		esp8266_host_key host;
+		uint16_t port;
+		unsigned long lastUsed;
+		bool keyed;
+		bool idle;
+	} _pool[ESP8266_MAX_SOCK_NUM];
+	uint8_t _poolSize;
+	unsigned long _poolTimeout;
+
+#ifdef ESP8266_TRACE
+	ESP8266Trace _trace;
+#endif
+
+#ifdef ESP8266_STATS
+	/// statsCommand([line]) - Which kind of command [line] (after the "AT") is
+	static uint8_t statsCommand(const char * line);
+	void statsResult(int16_t rsp);
+
+	esp8266_stats _stats;
+	uint8_t _statsCommand;
+	unsigned long _statsStart;
+
+	/// linkRtt([linkID], [sent]) - A segment sent at [sent] has its SEND OK
+	void linkRtt(uint8_t linkID, unsigned long sent);
+
+	esp8266_link_stats _linkStats[ESP8266_MAX_SOCK_NUM];
+	unsigned long _segmentSent;
+#endif
+
 	esp8266_status _status;
 
 	uint8_t sync();
@@ -12,6 +12,11 @@ const char RESPONSE_OK[] = "OK\r\n";
 const char RESPONSE_ERROR[] = "ERROR\r\n";
 const char RESPONSE_FAIL[] = "FAIL";
 const char RESPONSE_READY[] = "READY!";
+const char RESPONSE_PROMPT[] = ">";
+const char RESPONSE_SEND_OK[] = "\nSEND OK\r\n"; // (not <link>,<segment>,SEND OK)
+const char RESPONSE_SEND_FAIL[] = "\nSEND FAIL\r\n";
+const char RESPONSE_RECV[] = " bytes\r\n"; // Recv <n> bytes
+const char RESPONSE_BUSY[] = "busy";
 
 // Basic AT Commands 
 const char ESP8266_TEST[] = "";	
@@ -37,12 +42,16 @@ const char ESP8266_GET_STA_MAC[] = "+CIPSTAMAC_DEF"; // Get MAC address of stati
 const char ESP8266_TCP_STATUS[] = "+CIPSTATUS"; // Get connection status
 const char ESP8266_TCP_CONNECT[] = "+CIPSTART"; // Establish TCP connection or register UDP port
 const char ESP8266_TCP_SEND[] = "+CIPSEND"; // Send Data
+const char ESP8266_TCP_SEND_BUF[] = "+CIPSENDBUF"; // Write data into the TCP send buffer
+const char ESP8266_TCP_BUF_STATUS[] = "+CIPBUFSTATUS"; // Check the status of the TCP send buffer
 const char ESP8266_TCP_CLOSE[] = "+CIPCLOSE"; // Close TCP/UDP connection
 const char ESP8266_GET_LOCAL_IP[] = "+CIFSR"; // Get local IP address
 const char ESP8266_TCP_MULTIPLE[] = "+CIPMUX"; // Set multiple connections mode
 const char ESP8266_SERVER_CONFIG[] = "+CIPSERVER"; // Configure as server
 const char ESP8266_TRANSMISSION_MODE[] = "+CIPMODE"; // Set transmission mode
 const char ESP8266_PING[] = "+PING"; // Function PING
+const char ESP8266_DATA_INFO[] = "+CIPDINFO"; // Show remote IP and port with +IPD
+const char ESP8266_DNS_LOOKUP[] = "+CIPDOMAIN"; // DNS function
 
 // Extra TCP/IP Commands for SSL
 const char ESP8266_TCP_SSL[] = "+CIPSSLSIZE"; // Set the size of the SSL buffer